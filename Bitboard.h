@@ -1,34 +1,38 @@
 #pragma once
 
 #include <cstdint>
+#include <bit>
 
 // GROUP B SKILL: simple OOP
+// note: every method is defined inline in this header, since they are called in the innermost loops
+// of move generation and search, where the cost of a function call would dominate
 class Bitboard {
   public:
-    Bitboard();
-    Bitboard(uint64_t val);
+    // note: constexpr, so that static tables of bitboards are filled in at compile time, before any constructor runs
+    constexpr Bitboard() : m_board(0) {};
+    constexpr Bitboard(uint64_t val) : m_board(val) {};
     // GROUP C SKILL: simple data types
-    uint64_t getBits();
-    int getLsb();
+    uint64_t getBits() const { return m_board; }
+    int getLsb() const;
     int popLsb();
-    int popcnt();
+    int popcnt() const { return std::__popcount(m_board); }
 
-    Bitboard operator= (Bitboard op);
-    bool operator== (Bitboard op);
-    bool operator!= (Bitboard op);
-    Bitboard operator~ ();
-    Bitboard operator>> (int op);
-    Bitboard operator>>= (int op);
-    Bitboard operator<< (int op);
-    Bitboard operator<<= (int op);
-    Bitboard operator^ (Bitboard op);
-    Bitboard operator^= (Bitboard op);
-    Bitboard operator& (Bitboard op);
-    Bitboard operator&= (Bitboard op);
-    Bitboard operator| (Bitboard op);
-    Bitboard operator|= (Bitboard op);
-    Bitboard operator* (Bitboard op);
-    Bitboard operator*= (Bitboard op);
+    Bitboard operator= (Bitboard op) { m_board = op.getBits(); return m_board; }
+    bool operator== (Bitboard op) const { return m_board == op.getBits(); }
+    bool operator!= (Bitboard op) const { return m_board != op.getBits(); }
+    Bitboard operator~ () const { return ~m_board; }
+    Bitboard operator>> (int op) const { return m_board >> op; }
+    Bitboard operator>>= (int op) { m_board >>= op; return m_board; }
+    Bitboard operator<< (int op) const { return m_board << op; }
+    Bitboard operator<<= (int op) { m_board <<= op; return m_board; }
+    Bitboard operator^ (Bitboard op) const { return m_board ^ op.getBits(); }
+    Bitboard operator^= (Bitboard op) { m_board ^= op.getBits(); return m_board; }
+    Bitboard operator& (Bitboard op) const { return m_board & op.getBits(); }
+    Bitboard operator&= (Bitboard op) { m_board &= op.getBits(); return m_board; }
+    Bitboard operator| (Bitboard op) const { return m_board | op.getBits(); }
+    Bitboard operator|= (Bitboard op) { m_board |= op.getBits(); return m_board; }
+    Bitboard operator* (Bitboard op) const { return m_board * op.getBits(); }
+    Bitboard operator*= (Bitboard op) { m_board |= op.getBits(); return m_board; }
     
   private:
     // BITBOARD INDEX SYSTEM:
@@ -46,3 +50,24 @@ class Bitboard {
     uint64_t m_board;
 
 };
+
+inline int Bitboard::getLsb() const {
+  if(m_board == 0) return -1;
+  uint64_t bb = m_board & -m_board; // extract the lsb
+  // binary search to find index of the bit
+  // GROUP B SKILL: binary search
+  int index = 0;
+  if(bb>>32) { bb>>=32; index+=32; }
+  if(bb>>16) { bb>>=16; index+=16; }
+  if(bb>>8) { bb>>=8; index+=8; }
+  if(bb>>4) { bb>>=4; index+=4; }
+  if(bb>>2) { bb>>=2; index+=2; }
+  if(bb>>1) { bb>>=1; index++; }
+  return index;
+}
+
+inline int Bitboard::popLsb() {
+  int index = getLsb();
+  m_board &= m_board - 1; // wipe the lsb
+  return index;
+}
@@ -1,122 +1,184 @@
 #include "Engine.h"
 #include "Move.h"
 #include "Util.h"
+#include "MovePicker.h"
 #include <math.h>
-#include <random>
 #include <vector>
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+Engine::Engine() : m_tree(DEFAULT_MCTS_MB), m_tt(DEFAULT_HASH_MB) {
+  m_tree.reset(Move(0, 0)); // dummy move
+  setThreads(1);
+  initReductions();
+  m_options.simdSelection = m_tree.getUseSimd();
+}
+
+Engine::Engine(std::string FEN) : m_tree(DEFAULT_MCTS_MB), m_tt(DEFAULT_HASH_MB) {
+  setPosition(FEN);
+  setThreads(1);
+  initReductions();
+  m_options.simdSelection = m_tree.getUseSimd();
+}
+
+// GROUP C SKILL: simple mathematical calculations
+// later moves at greater depths are reduced more, growing with the log of both
+void Engine::initReductions() {
+  for(int depth=0; depth<64; ++depth) {
+    for(int moveCount=0; moveCount<64; ++moveCount) {
+      m_reductions[depth][moveCount] = (depth && moveCount) ? (int) (0.5 + log(depth) * log(moveCount) / 2) : 0;
+    }
+  }
+}
+
+void Engine::setPosition(std::string FEN) {
+  m_pos = Position(FEN);
+  m_tree.reset(Move(0, 0)); // dummy move
+  m_history.count = 0;
+  m_tt.clear();
+}
+
+bool Engine::setHashSize(int sizeMB) {
+  return m_tt.resize(sizeMB);
+}
+
+int Engine::getHashSize() {
+  return m_tt.getSizeMB();
+}
+
+void Engine::setThreads(int threads) {
+  m_threads.resize(std::max(threads, 1));
+  for(size_t i=0; i<m_threads.size(); ++i) {
+    if(!m_threads[i]) {
+      m_threads[i] = std::unique_ptr<SearchThread>(new SearchThread());
+      m_threads[i]->rng.seed(m_seed + i);
+    }
+  }
+}
 
-MCTSNode::MCTSNode(Position& pos, Move move) : pos(pos), move(move) {
-  score = 0;
-  playouts = 0;
-  parent = nullptr;
+int Engine::getThreads() {
+  return m_threads.size();
 }
 
-Engine::Engine() {
-  m_root = std::shared_ptr<MCTSNode>(new MCTSNode(m_pos, Move(-1, -1, empty, false, false, false))); // dummy move
-  initZobrist();
+void Engine::setSeed(uint64_t seed) {
+  m_seed = seed;
+  for(size_t i=0; i<m_threads.size(); ++i) m_threads[i]->rng.seed(m_seed + i);
 }
 
-Engine::Engine(std::string FEN) {
-  Position p(FEN);
-  m_pos = p;
-  m_root = std::shared_ptr<MCTSNode>(new MCTSNode(m_pos, Move(-1, -1, empty, false, false, false))); // dummy move
-  initZobrist();
+uint64_t Engine::getSeed() {
+  return m_seed;
 }
+
+void Engine::setSearchOptions(SearchOptions options) {
+  // SIMD selection stays off if the CPU can't do it
+  if(!m_tree.setUseSimd(options.simdSelection)) options.simdSelection = false;
+  m_options = options;
+}
+
+SearchOptions Engine::getSearchOptions() {
+  return m_options;
+}
+
 Position Engine::getPos() {
   return m_pos;
 }
 
-std::vector<Move> Engine::getLegalMoves() {
-  return m_gen.genMoves(m_pos, false);
+MoveList Engine::getLegalMoves() {
+  MoveList legalMoves;
+  m_gen.genMoves(m_pos, legalMoves, ALL);
+  return legalMoves;
 }
 
 void Engine::makeMove(Move move) {
-  m_prevPositions.push_back(m_pos);
-  updateZobrist(move, m_pos.makeMove(move));
-  m_root = std::shared_ptr<MCTSNode>(new MCTSNode(m_pos, move));
+  m_history.push(m_pos.getKey());
+  StateInfo state;
+  m_pos.makeMove(move, state);
+  m_tree.reset(move);
 }
 
 // GROUP A SKILL: complex user-defined algorithms
-void Engine::doOneMonteCarloStep(bool alphaBeta, std::chrono::time_point<std::chrono::steady_clock> startTime_ms) {
+void Engine::doOneMonteCarloStep(SearchThread& t, bool alphaBeta) {
 
   // GROUP A SKILL: tree traversal
   // SELECTION
-  std::shared_ptr<MCTSNode> curNode = m_root;
-  while(curNode->children.size()>0) {
-    // choose the child node with the largest value of w_i/n_i + sqrt(c*ln(n_{i-1})/n_i)
-    // where c is an adjustable constant to control the exploitation / exploration ratio
-    // note: 0.000001 is added to n_i since dividing by 0 is undefined
-    std::shared_ptr<MCTSNode> nextNode;
-    double maxVal = -1;
-    for(auto child : curNode->children) {
-      // GROUP C SKILL: simple mathematical calculations
-      double val = child->score / (child->playouts+0.000001) + sqrt(2*log2(curNode->playouts) / (child->playouts+0.000001) );
-      if(val>maxVal) {
-        maxVal = val;
-        nextNode = child;
-      }
-    }
-    curNode = nextNode;
+  uint32_t cur = m_tree.getRoot();
+  int keyHistoryCount = t.history.count; // the keys of the path to the leaf are pushed, and popped after backpropagation
+  // the nodes don't store positions, so the moves to the leaf are played from the root
+  Position& p = t.pos;
+  p = m_pos;
+  StateInfo state; // moves are never undone, so this is overwritten every ply
+  // the number of playouts of the current node before this one, which is counted straight away (virtual loss)
+  uint32_t prevPlayouts = m_tree.getPlayouts(cur).fetch_add(1, std::memory_order_relaxed);
+  uint32_t firstChild;
+  // note: a node that another thread is expanding is treated as a leaf
+  while((firstChild = m_tree.getNode(cur).firstChild.load(std::memory_order_acquire)) < MCTSTree::EXPANDING) {
+    // choose the child node with the largest UCT value
+    uint32_t next = m_tree.selectChild(cur, firstChild);
+    t.history.push(p.getKey());
+    p.makeMove(m_tree.getNode(next).move, state);
+    cur = next;
+    prevPlayouts = m_tree.getPlayouts(cur).fetch_add(1, std::memory_order_relaxed);
   }
 
   // EXPANSION
   // create new nodes, but only if the current one has at least one playout
-  if(curNode->playouts > 0) {
-    std::vector<Move> legalMoves = m_gen.genMoves(curNode->pos, false);
-    if(legalMoves.size()>0) {
-      for(Move move : legalMoves) {
-        Position nextPos = curNode->pos;
-        nextPos.makeMove(move);
-        // GROUP A SKILL: linked list maintenance
-        std::shared_ptr<MCTSNode> newNode = std::shared_ptr<MCTSNode>(new MCTSNode(nextPos, move));
-        newNode->parent = curNode;
-        curNode->children.push_back(newNode);
-      }
+  if(prevPlayouts > 0) {
+    MoveList legalMoves;
+    m_gen.genMoves(p, legalMoves, ALL);
+    if(legalMoves.size()>0 && (firstChild = m_tree.expand(cur, legalMoves)) != MCTSTree::NO_NODE) {
       // pick random child
-      curNode = curNode->children[rand() % curNode->children.size()];
+      t.history.push(p.getKey());
+      cur = firstChild + t.rng.nextBelow(legalMoves.size());
+      m_tree.getPlayouts(cur).fetch_add(1, std::memory_order_relaxed);
+      p.makeMove(m_tree.getNode(cur).move, state);
     }
   }
 
   // SIMULATION
-  Position p = curNode->pos;
   // 1 for loss, 0.5 for draw, 0 for win (from this position)
   // since e.g. if current position is checkmate, then result is 1 because the previous node wants to go to this node
   double result;
 
   if(alphaBeta) {
-    Move bestMove(-1, -1, empty, false, false, false); // dummy move
-    double eval = minimaxAB(p, startTime_ms, m_inf, 2, -m_inf, m_inf); 
+    Move bestMove(0, 0); // dummy move
+    double eval = minimaxAB(t, 0, 2, -m_inf, m_inf);
     // GROUP C SKILL: simple mathematical calculations
     result = 0.5 + 0.5*tanh(-0.15*eval); // positive eval means result should be closer to 0
-  } else result = playout(p);
-  
+  } else result = playout(t);
+  t.history.count = keyHistoryCount;
+
 
   // BACKPROPAGATION
   // travel back up the tree, updating the information
-  while(true) {
-    curNode->score += result;
-    curNode->playouts++;
+  // note: the playouts were already counted on the way down
+  while(cur != MCTSTree::NO_NODE) {
+    m_tree.addScore(cur, result);
     // flip the result because the player flips between black and white
     result = 1-result;
-    curNode = curNode->parent;
-    if(curNode==nullptr) break; 
+    cur = m_tree.getNode(cur).parent;
   }
 
 }
 
 // GROUP A SKILL: complex user-defined algorithms
-double Engine::playout(Position& p) {
+double Engine::playout(SearchThread& t) {
+  Position& p = t.pos;
+  MoveList legalMoves;
+  StateInfo state; // moves are never undone, so this is overwritten every ply
   while(true) {
-    std::vector<Move> legalMoves = m_gen.genMoves(p, false);
+    m_gen.genMoves(p, legalMoves, ALL);
 
     // terminal conditions
     if(legalMoves.size()==0)
       return m_gen.getCheckingPieces(p).getBits()==0 ? 0.5 : 1; // if no legal moves, then stalemate if not being checked, else loss
     if(p.getPlysSince50()>50) // if the 50 move rule has been exceeded, it is probably a draw, so evaluate the playout as a draw to save time
       return 0.5;
+    if(t.history.isRepetition(p))
+      return 0.5;
     if(p.getWhiteOccupancy().popcnt()==1) { // if white only has a king left
       bool isWhite = p.isWhiteToMove();
       if(p.getPieces(br).popcnt()) return isWhite ? 1 : 0; // rook endgame
@@ -140,7 +202,9 @@ double Engine::playout(Position& p) {
     }
 
     // play a random legal move
-    p.makeMove(legalMoves[rand() % legalMoves.size()]);
+    // note: the pushed keys are popped by the caller
+    t.history.push(p.getKey());
+    p.makeMove(legalMoves[t.rng.nextBelow(legalMoves.size())], state);
   }
 }
 
@@ -151,91 +215,263 @@ int getTimeElapsed(std::chrono::time_point<std::chrono::steady_clock> begin) {
 // GROUP A SKILL: complex user-defined algorithms
 // GROUP A SKILL: recursion
 // alpha beta minimax
-double Engine::minimaxAB(Position& p, std::chrono::time_point<std::chrono::steady_clock> startTime_ms, int timeLimit_ms, int depth, double alpha, double beta) {
-  
+double Engine::minimaxAB(SearchThread& t, int ply, int depth, double alpha, double beta) {
+
+  Position& p = t.pos;
+  t.nodes++;
+
+  // a repeated position is scored as a draw, since the side that repeated it could repeat it again
+  if(t.history.isRepetition(p)) return 0;
+
   // GROUP A SKILL: hashing
   // try and lookup the position to see if already evaluated
-  auto el = m_hashTable[m_zobrist % getHashTableSize()];
-  if(el.type != UNKNOWN && el.key == m_zobrist && el.depth >= depth) {
-    if(el.type == EXACT) return el.eval;
-    if(el.type == UPPER && el.eval <= alpha) return alpha;
-    if(el.type == LOWER && el.eval >= beta) return beta;
+  uint64_t key = p.getKey();
+  HashTableEntry el;
+  Move hashMove(0, 0); // dummy move
+  bool hashHit = m_tt.probe(key, el);
+  SEARCH_STAT(t.stats.hashProbes++);
+  if(hashHit) {
+    SEARCH_STAT(t.stats.hashHits++);
+    hashMove = el.move;
+    // quiescence results can't be used, since they don't detect checkmate and stalemate
+    if(el.depth >= depth && el.depth != HashTableEntry::DEPTH_QUIESCENCE) {
+      double hashEval = scoreFromHash(el.score);
+      if(el.getType() == EXACT || (el.getType() == UPPER && hashEval <= alpha) || (el.getType() == LOWER && hashEval >= beta)) {
+        SEARCH_STAT(t.stats.hashCutoffs++);
+        return el.getType() == EXACT ? hashEval : std::clamp(hashEval, alpha, beta);
+      }
+    }
   }
 
-  std::vector<Move> legalMoves = m_gen.genMoves(p, false);
-  if(legalMoves.size() == 0) {
-    return m_gen.getCheckingPieces(p).getBits()==0 ? 0 : -m_inf;
+  if(depth == 0 || ply >= MAX_PLY-1) {
+    // checkmate and stalemate have to be detected before the captures search, which would just evaluate them
+    MoveList& legalMoves = t.moveLists[ply];
+    m_gen.genMoves(p, legalMoves, ALL);
+    if(legalMoves.size() == 0) {
+      return m_gen.getCheckingPieces(p).getBits()==0 ? 0 : -m_inf;
+    }
+    return capturesAB(t, ply, alpha, beta);
   }
-  order(p, legalMoves);
 
-  if(depth == 0) {
-    return capturesAB(p, startTime_ms, timeLimit_ms, alpha, beta);
+  bool inCheck = m_gen.getCheckingPieces(p).getBits() != 0;
+  // outside the principal variation the window is null, and only has to prove that a move is no better
+  bool pvNode = beta - alpha > 2*m_nullWindow;
+  double staticEval = inCheck ? -m_inf : cachedEval(p, hashHit, el);
+  int storedEval = inCheck ? HashTableEntry::NO_EVAL : scoreToHash(staticEval);
+  // note: a null move is stored as Move(0, 0)
+  bool hasPrevMove = ply > 0 && t.plyMoves[ply-1] != Move(0, 0);
+
+  // reverse futility pruning: near the leaves, a position far above beta is very unlikely to drop below it
+  if(m_options.futilityPruning && !pvNode && !inCheck && depth <= FUTILITY_DEPTH && staticEval - m_futilityMargin*depth >= beta) {
+    return beta;
   }
 
+  // null move pruning: if passing the turn still fails high, then a real move almost certainly would too
+  // not done twice in a row, or with only pawns left, where zugzwang is common and passing may be the best "move"
+  if(m_options.nullMovePruning && !pvNode && !inCheck && depth >= 3 && staticEval >= beta
+     && (ply == 0 || hasPrevMove) && hasNonPawnMaterial(p)) {
+    int reduction = NULL_MOVE_REDUCTION + depth/4;
+    StateInfo state;
+    t.plyMoves[ply] = Move(0, 0);
+    t.plyPieces[ply] = empty;
+    t.history.push(key);
+    p.makeNullMove(state);
+    double evaluation = -minimaxAB(t, ply+1, std::max(depth-1-reduction, 0), -beta, -beta+m_nullWindow);
+    p.unmakeNullMove(state);
+    t.history.pop();
+    if(isTimeUp(t)) return 0;
+    if(evaluation >= beta) return beta;
+  }
+
+  // futility pruning: near the leaves, a quiet move is very unlikely to raise a position far below alpha up to it
+  bool futile = m_options.futilityPruning && !pvNode && !inCheck && depth <= FUTILITY_DEPTH
+    && staticEval + m_futilityMargin*depth <= alpha;
+
+  int side = p.isWhiteToMove() ? 0 : 1;
+  PieceType prevPiece = hasPrevMove ? t.plyPieces[ply-1] : empty;
+  int prevEnd = hasPrevMove ? t.plyMoves[ply-1].getEnd() : 0;
+  MovePicker picker(p, m_gen, t.moveLists[ply], t.quietLists[ply], hashMove,
+    t.killers[ply][0], t.killers[ply][1], hasPrevMove ? t.counterMoves[prevPiece][prevEnd] : Move(0, 0),
+    t.butterflyHistory[side], hasPrevMove ? t.getContinuationHistoryRow(prevPiece, prevEnd) : nullptr, m_pieceValues);
+  MoveList quietsTried; // quiet moves that didn't cause a cutoff, which are punished if a later one does
+
   HashType type = UPPER;
-  for(Move move : legalMoves) {
-    Position newPos = p;
-    int castling = newPos.makeMove(move);
-    updateZobrist(move, castling);
-    double evaluation = -minimaxAB(newPos, startTime_ms, timeLimit_ms, depth-1, -beta, -alpha);
-    updateZobrist(move, castling);
+  Move bestMove = Move(0, 0);
+  int moveCount = 0;
+  Move move;
+  while((move = picker.next()) != Move(0, 0)) {
+    bool quiet = p.isQuiet(move);
+    StateInfo state;
+    t.plyMoves[ply] = move;
+    t.plyPieces[ply] = p.whichPiece(move.getStart());
+    t.history.push(key);
+    p.makeMove(move, state);
+    bool givesCheck = m_gen.getCheckingPieces(p).getBits() != 0;
+    if(futile && quiet && !givesCheck && moveCount > 0) {
+      p.unmakeMove(move, state);
+      t.history.pop();
+      continue;
+    }
+    m_tt.prefetch(p.getKey());
+    // principal variation search: the first move is searched with the full window
+    // the rest are expected to be worse, so only a null window is used to prove it, re-searching if the proof fails
+    double evaluation;
+    if(moveCount == 0) evaluation = -minimaxAB(t, ply+1, depth-1, -beta, -alpha);
+    else {
+      // late move reductions: with good move ordering, late quiet moves rarely cause a cutoff, so search them less deeply
+      // and only to full depth if they beat alpha anyway
+      int reduction = 0;
+      if(m_options.lateMoveReductions && depth >= 3 && moveCount >= 3 && quiet && !inCheck && !givesCheck) {
+        reduction = m_reductions[std::min(depth, 63)][std::min(moveCount, 63)] - (pvNode ? 1 : 0);
+        reduction = std::clamp(reduction, 0, depth-2);
+      }
+      evaluation = -minimaxAB(t, ply+1, depth-1-reduction, -alpha-m_nullWindow, -alpha);
+      if(reduction > 0 && evaluation > alpha)
+        evaluation = -minimaxAB(t, ply+1, depth-1, -alpha-m_nullWindow, -alpha);
+      if(evaluation > alpha && evaluation < beta)
+        evaluation = -minimaxAB(t, ply+1, depth-1, -beta, -alpha);
+    }
+    p.unmakeMove(move, state);
+    t.history.pop();
+    // a stopped search returns a meaningless score, which mustn't be stored or cause a cutoff
+    if(isTimeUp(t)) return 0;
     if(evaluation >= beta) {
-      writeHash(depth, beta, LOWER);
+      SEARCH_STAT(t.stats.cutoffs++);
+      SEARCH_STAT(if(moveCount == 0) t.stats.firstMoveCutoffs++);
+      if(quiet) updateQuietHeuristics(t, ply, depth, move, quietsTried);
+      m_tt.store(key, move, scoreToHash(beta), depth, LOWER, storedEval);
       return beta;
     }
+    if(moveCount == 0) bestMove = move;
     if(evaluation > alpha) {
       alpha = evaluation;
       type = EXACT;
+      bestMove = move;
     }
-    if(getTimeElapsed(startTime_ms) >= timeLimit_ms) return 0;
+    if(quiet) quietsTried.push_back(move);
+    moveCount++;
   }
-  
-  writeHash(depth, alpha, type);
+
+  // no legal moves
+  if(moveCount == 0) {
+    return m_gen.getCheckingPieces(p).getBits()==0 ? 0 : -m_inf;
+  }
+
+  m_tt.store(key, bestMove, scoreToHash(alpha), depth, type, storedEval);
   return alpha;
 }
 
 // GROUP A SKILL: recursion
-double Engine::capturesAB(Position& p, std::chrono::time_point<std::chrono::steady_clock> startTime_ms, int timeLimit_ms, double alpha, double beta) {
-  // captures aren't forced, so check the eval before making a capture
-  // otherwise, if only bad captures are available then this will evaluate the position as bad, even if other good moves exist
-  double evaluation = eval(p);
-  if(evaluation >= beta) return beta;
-  if(evaluation > alpha) alpha = evaluation;
+// note: every move searched here resets the 50 move counter, so no position after the first can be a repetition,
+//       and the first one has already been checked by minimaxAB
+double Engine::capturesAB(SearchThread& t, int ply, double alpha, double beta) {
+  Position& p = t.pos;
+  t.nodes++;
+  SEARCH_STAT(t.stats.capturesNodes++);
 
-  std::vector<Move> captureMoves = m_gen.genMoves(p, true);
-  order(p, captureMoves);
+  // GROUP A SKILL: hashing
+  // every result here is from a captures search, so any stored result is deep enough
+  uint64_t key = p.getKey();
+  HashTableEntry el;
+  bool hashHit = m_tt.probe(key, el);
+  SEARCH_STAT(t.stats.hashProbes++);
+  if(hashHit) {
+    SEARCH_STAT(t.stats.hashHits++);
+    double hashEval = scoreFromHash(el.score);
+    if(el.getType() == EXACT || (el.getType() == UPPER && hashEval <= alpha) || (el.getType() == LOWER && hashEval >= beta)) {
+      SEARCH_STAT(t.stats.hashCutoffs++);
+      return std::clamp(hashEval, alpha, beta);
+    }
+  }
 
-  for(Move move : captureMoves) {
-    Position newPos = p;
-    newPos.makeMove(move);
-    double evaluation = -capturesAB(newPos, startTime_ms, timeLimit_ms, -beta, -alpha);
-    if(evaluation >= beta) return beta;
-    if(evaluation > alpha) alpha = evaluation;
-    if(getTimeElapsed(startTime_ms) >= timeLimit_ms) return 0;
+  // captures aren't forced, so check the eval before making a capture
+  // otherwise, if only bad captures are available then this will evaluate the position as bad, even if other good moves exist
+  double standPat = cachedEval(p, hashHit, el);
+  int storedEval = scoreToHash(standPat);
+  if(standPat >= beta) {
+    m_tt.store(key, Move(0, 0), scoreToHash(beta), HashTableEntry::DEPTH_QUIESCENCE, LOWER, storedEval);
+    return beta;
+  }
+  // delta pruning: if even capturing a queen can't bring the eval up to alpha, no capture can
+  // unless a pawn can also promote, which gains up to another queen (less the pawn)
+  bool isWhite = p.isWhiteToMove();
+  Bitboard promotingRank = isWhite ? 0x00ff000000000000 : 0x000000000000ff00;
+  double maxGain = m_pieceValues[wq];
+  if((p.getPieces(isWhite ? wp : bp) & promotingRank).getBits()) maxGain += m_pieceValues[wq] - m_pieceValues[wp];
+  if(standPat + maxGain + m_deltaMargin <= alpha) return alpha;
+  HashType type = UPPER;
+  if(standPat > alpha) {
+    alpha = standPat;
+    type = EXACT;
+  }
+  if(ply >= MAX_PLY) return alpha; // out of preallocated move lists
+
+  MovePicker picker(p, m_gen, t.moveLists[ply], m_pieceValues);
+  Move bestMove = Move(0, 0);
+  Move move;
+  while((move = picker.next()) != Move(0, 0)) {
+    // delta pruning: skip captures that can't bring the eval up to alpha, even with a positional bonus of (m_deltaMargin)
+    if(!move.getPromotion()) {
+      PieceType captured = move.isEnPassant() ? wp : p.whichPiece(move.getEnd());
+      if(standPat + m_pieceValues[captured] + m_deltaMargin <= alpha) continue;
+    }
+    StateInfo state;
+    p.makeMove(move, state);
+    m_tt.prefetch(p.getKey());
+    double evaluation = -capturesAB(t, ply+1, -beta, -alpha);
+    p.unmakeMove(move, state);
+    if(isTimeUp(t)) return 0;
+    if(evaluation >= beta) {
+      m_tt.store(key, move, scoreToHash(beta), HashTableEntry::DEPTH_QUIESCENCE, LOWER, storedEval);
+      return beta;
+    }
+    if(evaluation > alpha) {
+      alpha = evaluation;
+      type = EXACT;
+      bestMove = move;
+    }
   }
 
+  m_tt.store(key, bestMove, scoreToHash(alpha), HashTableEntry::DEPTH_QUIESCENCE, type, storedEval);
   return alpha;
 
 }
 
+// GROUP C SKILL: simple mathematical calculations
+// moves (entry) towards +-MAX_HISTORY by (bonus), by less the closer it already is, so that it stays within range
+template<typename T>
+void addHistoryBonus(T& entry, int bonus) {
+  entry += bonus - entry * abs(bonus) / MAX_HISTORY;
+}
+
 // GROUP B SKILL: simple user-defined algorithms
-void Engine::order(Position& p, std::vector<Move>& moves) {
-  std::sort(moves.begin(), moves.end(), [&](const Move& m1, const Move& m2) -> bool {
-    int score1 = 0;
-    PieceType capturedPiece1 = p.whichPiece(m1.end);
-    // reward capturing valuable pieces with less valuable ones
-    if(capturedPiece1 != empty) score1 += 10 * m_pieceValues[capturedPiece1] - m_pieceValues[m1.piece];
-    // pawn promotions are probably good
-    if(m1.promotion) score1 += m_pieceValues[m1.promotion];
-
-    // same for second move
-    int score2 = 0;
-    PieceType capturedPiece2 = p.whichPiece(m2.end);
-    if(capturedPiece2 != empty) score2 += 10 * m_pieceValues[capturedPiece2] - m_pieceValues[m2.piece];
-    if(m2.promotion) score2 += m_pieceValues[m2.promotion];
-
-    return score1 > score2;
-  });
+void Engine::updateQuietHeuristics(SearchThread& t, int ply, int depth, Move move, MoveList& quietsTried) {
+  Position& p = t.pos;
+  int side = p.isWhiteToMove() ? 0 : 1;
+  bool hasPrevMove = ply > 0 && t.plyMoves[ply-1] != Move(0, 0); // not after a null move
+  PieceType prevPiece = hasPrevMove ? t.plyPieces[ply-1] : empty;
+  int prevEnd = hasPrevMove ? t.plyMoves[ply-1].getEnd() : 0;
+
+  if(t.killers[ply][0] != move) {
+    t.killers[ply][1] = t.killers[ply][0];
+    t.killers[ply][0] = move;
+  }
+  if(hasPrevMove) t.counterMoves[prevPiece][prevEnd] = move;
+
+  // deeper cutoffs save more work, so are rewarded more
+  int bonus = std::min(depth*depth, 400);
+  addHistoryBonus(t.butterflyHistory[side][move.getStart()][move.getEnd()], bonus);
+  if(hasPrevMove) addHistoryBonus(t.getContinuationHistoryRow(prevPiece, prevEnd)[p.whichPiece(move.getStart())*64 + move.getEnd()], bonus);
+  for(Move m : quietsTried) {
+    addHistoryBonus(t.butterflyHistory[side][m.getStart()][m.getEnd()], -bonus);
+    if(hasPrevMove) addHistoryBonus(t.getContinuationHistoryRow(prevPiece, prevEnd)[p.whichPiece(m.getStart())*64 + m.getEnd()], -bonus);
+  }
+}
+
+bool Engine::hasNonPawnMaterial(Position& p) {
+  Bitboard pawnsAndKings = p.getPieces(wp) | p.getPieces(wk) | p.getPieces(bp) | p.getPieces(bk);
+  Bitboard own = p.isWhiteToMove() ? p.getWhiteOccupancy() : p.getBlackOccupancy();
+  return (own & ~pawnsAndKings).getBits() != 0;
 }
 
 // GROUP A SKILL: complex user-defined algorithms
@@ -285,77 +521,263 @@ double Engine::eval(Position& p) {
 
 Move Engine::MCTS(int timeLimit_ms, bool alphaBeta, bool verbose) {
   auto begin = std::chrono::steady_clock::now();
-  while(getTimeElapsed(begin) < timeLimit_ms) {
-    doOneMonteCarloStep(alphaBeta, begin);
+  m_tt.newSearch();
+  m_stop = false;
+  // the minimax searches of MCTS-AB are too short to stop part way through
+  m_time.startInfinite();
+
+  // tree parallelisation: every thread runs Monte Carlo steps on the same tree
+  auto runSteps = [this, begin, timeLimit_ms, alphaBeta](SearchThread& t) {
+    t.history = m_history;
+    t.nextTimeCheck = 0;
+    while(getTimeElapsed(begin) < timeLimit_ms) {
+      doOneMonteCarloStep(t, alphaBeta);
+    }
+  };
+  std::vector<std::thread> helpers;
+  for(int i=1; i<(int)m_threads.size(); ++i) {
+    helpers.push_back(std::thread(runSteps, std::ref(*m_threads[i])));
   }
+  runSteps(*m_threads[0]);
+  for(std::thread& helper : helpers) helper.join();
+
   // return the move with the most number of playouts
-  if(m_root->children.size()==0) return Move(-1, -1, empty, false, false, false); // dummy move
-  std::sort(m_root->children.begin(), m_root->children.end(), [](const std::shared_ptr<MCTSNode> a, const std::shared_ptr<MCTSNode> b) -> bool {return a->playouts > b->playouts;});
+  MCTSNode& root = m_tree.getNode(m_tree.getRoot());
+  if(root.firstChild.load() >= MCTSTree::EXPANDING) return Move(0, 0); // dummy move
+  // the children can't be reordered in the arena, since their own children point back to them
+  std::vector<uint32_t> children;
+  uint32_t firstChild = root.firstChild.load();
+  for(uint32_t i=firstChild; i<firstChild+root.numChildren; ++i) children.push_back(i);
+  std::sort(children.begin(), children.end(), [this](uint32_t a, uint32_t b) -> bool {return m_tree.getPlayouts(a).load() > m_tree.getPlayouts(b).load();});
   if(verbose) {
     std::cout << "Monte Carlo win rates for each move: (format: score/playouts)\n";
-    for(auto child : m_root->children) {
-      std::cout << "  " << (char)((child->move.start&7)+'a') << (child->move.start>>3)+1
-        << (char)((child->move.end&7)+'a') << (child->move.end>>3)+1
-        << ": " << child->score << "/" << child->playouts << "\n";
+    for(uint32_t i : children) {
+      MCTSNode& child = m_tree.getNode(i);
+      std::cout << "  " << (char)((child.move.getStart()&7)+'a') << (child.move.getStart()>>3)+1
+        << (char)((child.move.getEnd()&7)+'a') << (child.move.getEnd()>>3)+1
+        << ": " << m_tree.getScore(i).load() << "/" << m_tree.getPlayouts(i).load() << "\n";
     }
+    std::cout << "  (" << m_tree.size() << " nodes in the tree" << (m_tree.isFull() ? ", which is full" : "") << ")\n";
   }
-  return m_root->children[0]->move;
+  return m_tree.getNode(children[0]).move;
 
 }
 
-// GROUP A SKILL: complex user-defined algorithms
 Move Engine::minimax(int timeLimit_ms, bool verbose) {
-  auto begin = std::chrono::steady_clock::now();
-  std::vector<Move> legalMoves = m_gen.genMoves(m_pos, false);
-  if(legalMoves.size()==0) return Move(-1, -1, empty, false, false, false); // dummy move
+  m_time.startFixed(timeLimit_ms);
+  return minimax(verbose);
+}
+
+Move Engine::minimax(int time_ms, int increment_ms, int movesToGo, bool verbose) {
+  m_time.startClock(time_ms, increment_ms, movesToGo);
+  return minimax(verbose);
+}
+
+// GROUP A SKILL: complex user-defined algorithms
+Move Engine::minimax(bool verbose) {
+  m_tt.newSearch();
+  m_stop = false;
+
+  // every thread starts from its own copy of the game
+  for(auto& t : m_threads) {
+    t->pos = m_pos;
+    t->history = m_history;
+  }
+
+  // helper threads search the same position, filling the hash table with results that the main thread reuses
+  // half of them start a ply deeper, so that the threads aren't all searching the same depth at once
+  std::vector<std::thread> helpers;
+  for(int i=1; i<(int)m_threads.size(); ++i) {
+    helpers.push_back(std::thread([this, i]() {
+      iterativeDeepening(*m_threads[i], i%2, false);
+    }));
+  }
+
+  Move bestMove = iterativeDeepening(*m_threads[0], 0, verbose);
+
+  m_stop = true;
+  for(std::thread& helper : helpers) helper.join();
+
+  // every thread searched for the same time, so their counters are added up, for the total nodes per second
+  SEARCH_STAT(
+    for(auto& t : m_threads) t->stats.nodes = t->nodes;
+    m_searchStats = m_threads[0]->stats;
+    for(int i=1; i<(int)m_threads.size(); ++i) m_searchStats.add(m_threads[i]->stats);
+    m_searchStats.time_ms = m_time.getElapsed();
+  )
+
+  return bestMove;
+}
+
+SearchStats Engine::getSearchStats() {
+  return m_searchStats;
+}
+
+// reading the clock is slow compared to searching a node, so it is only read every TIME_CHECK_NODES nodes
+// note: whichever thread finds the hard limit has been reached stops all of them
+bool Engine::isTimeUp(SearchThread& t) {
+  if(t.nodes >= t.nextTimeCheck) {
+    t.nextTimeCheck = t.nodes + TIME_CHECK_NODES;
+    if(m_time.isHardLimitReached()) m_stop = true;
+  }
+  return m_stop.load(std::memory_order_relaxed);
+}
 
-  Move lastBestMove = Move(-1, -1, empty, false, false, false);
+// GROUP A SKILL: complex user-defined algorithms
+double Engine::searchRoot(SearchThread& t, int depth, double alpha, double beta) {
+  Position& p = t.pos;
+  bool firstMove = true;
+  bool failedHigh = false;
+  int bestIndex = -1; // the move that raised alpha last, or failed high, if any did
+  for(int i=0; i<(int)t.rootMoves.size(); ++i) {
+    RootMove& rm = t.rootMoves[i];
+    uint64_t nodesBefore = t.nodes;
+    StateInfo state;
+    t.plyMoves[0] = rm.move;
+    t.plyPieces[0] = p.whichPiece(rm.move.getStart());
+    t.history.push(p.getKey());
+    p.makeMove(rm.move, state);
+    // principal variation search, as in minimaxAB
+    double eval;
+    if(firstMove) eval = -minimaxAB(t, 1, depth, -beta, -alpha);
+    else {
+      eval = -minimaxAB(t, 1, depth, -alpha-m_nullWindow, -alpha);
+      if(eval > alpha && eval < beta)
+        eval = -minimaxAB(t, 1, depth, -beta, -alpha);
+    }
+    firstMove = false;
+    p.unmakeMove(rm.move, state);
+    t.history.pop();
+    if(isTimeUp(t)) return alpha;
+
+    rm.nodes = t.nodes - nodesBefore;
+    // the search is fail-hard, so a move that didn't raise alpha comes back as exactly alpha, tied with the move that did
+    // it has only been proven no better, so it is ranked below every move that raised alpha
+    rm.score = -m_inf;
+    if(eval >= beta) {
+      rm.score = beta;
+      t.iterationBestMove = rm.move;
+      t.iterationBestEval = beta;
+      bestIndex = i;
+      failedHigh = true;
+      break;
+    }
+    if(eval > alpha) {
+      rm.score = eval;
+      alpha = eval;
+      t.iterationBestMove = rm.move;
+      t.iterationBestEval = eval;
+      bestIndex = i;
+    }
+  }
+
+  // best move first, or the last best move again if none raised alpha, so the best move so far is always searched first
+  // then the moves that raised alpha before it, then the moves that took the most effort to refute, since they are
+  // the most likely to become best next time
+  // note: moves that weren't searched after a cutoff keep their old score
+  if(bestIndex > 0) std::rotate(t.rootMoves.begin(), t.rootMoves.begin() + bestIndex, t.rootMoves.begin() + bestIndex + 1);
+  std::stable_sort(t.rootMoves.begin() + 1, t.rootMoves.end(), [](const RootMove& a, const RootMove& b) -> bool {
+    if(a.score != b.score) return a.score > b.score;
+    return a.nodes > b.nodes;
+  });
+  return failedHigh ? beta : alpha;
+}
+
+// GROUP A SKILL: complex user-defined algorithms
+Move Engine::iterativeDeepening(SearchThread& t, int startDepth, bool verbose) {
+  MoveList legalMoves;
+  m_gen.genMoves(t.pos, legalMoves, ALL);
+  if(legalMoves.size()==0) return Move(0, 0); // dummy move
+
+  t.rootMoves.clear();
+  for(Move m : legalMoves) t.rootMoves.push_back({m, -m_inf, 0});
+  t.nodes = 0;
+  t.nextTimeCheck = 0;
+  t.stats.clear();
+  t.ageHeuristics();
+
+  Move lastBestMove = Move(0, 0);
   double lastBestEval = -m_inf;
+  // number of iterations in a row that have ended with the same best move
+  int stableIterations = 0;
+  // only the main thread decides when to stop, the helper threads are stopped by it
+  bool isMainThread = &t == m_threads[0].get();
 
   // iterative deepening
-  int curDepth = 0;
+  int curDepth = startDepth;
   while(true) {
-    bool timeLimitReached = false;
-
-    Move bestMove = Move(-1, -1, empty, false, false, false);
-    double bestEval = -m_inf;
-
-    for(Move m : legalMoves) {
-      Position p = m_pos;
-      int res = p.makeMove(m);
-      updateZobrist(m, res);
-      double eval = -minimaxAB(p, begin, timeLimit_ms, curDepth, -m_inf, -bestEval);
-      updateZobrist(m, res);
-      if(eval > m_inf/2) {
-        // stop as soon as mate reached, at lowest depth possible
-        if(verbose) std::cout << "Minimax found checkmate\n";
-        return m; 
-      }
-      if(getTimeElapsed(begin) >= timeLimit_ms) {
-        timeLimitReached = true;
-        break;
-      }
-      if(eval > bestEval) {
-        bestEval = eval;
-        bestMove = m;
-      }
+
+    // aspiration windows: the score is probably close to the last iteration's, so search a narrow window around it
+    // and widen the side that failed until the score lands inside
+    double delta = m_aspirationWindow;
+    double alpha = -m_inf;
+    double beta = m_inf;
+    if(curDepth > startDepth && fabs(lastBestEval) < m_inf/2) {
+      alpha = lastBestEval - delta;
+      beta = lastBestEval + delta;
+    }
+    double eval;
+    t.iterationBestMove = Move(0, 0);
+    SEARCH_STAT(uint64_t iterationStartNodes = t.nodes; int iterationStart_ms = m_time.getElapsed());
+    while(true) {
+      eval = searchRoot(t, curDepth, alpha, beta);
+      if(isTimeUp(t)) break;
+      delta *= 2;
+      if(eval <= alpha && alpha > -m_inf) {
+        alpha = (delta > 4) ? -m_inf : lastBestEval - delta;
+        // every move has just been refuted, including any that failed high in an earlier window
+        t.iterationBestMove = Move(0, 0);
+      } else if(eval >= beta && beta < m_inf) beta = (delta > 4) ? m_inf : lastBestEval + delta;
+      else break;
     }
 
-    if(timeLimitReached) break;
+    if(isTimeUp(t)) {
+      // the last iteration's best move is always searched first, so a move that beat alpha in the unfinished iteration is
+      // either that move or one that scored higher than it at the new depth, and the moves not yet searched were all
+      // proven no better than it at the last depth, so it is kept
+      if(t.iterationBestMove != Move(0, 0)) {
+        lastBestMove = t.iterationBestMove;
+        lastBestEval = t.iterationBestEval;
+        SEARCH_STAT(t.stats.unfinishedBestMove = t.iterationBestMove);
+        if(verbose) std::cout << "  depth " << curDepth << " unfinished, keeping its best move so far\n";
+      }
+      break;
+    }
 
     // search was completed at this depth, safe to update
-    lastBestMove = bestMove;
-    lastBestEval = bestEval;
+    // note: no move raises alpha if every move loses, in which case any of them will do
+    Move iterationBestMove = (t.iterationBestMove != Move(0, 0)) ? t.iterationBestMove : t.rootMoves[0].move;
+    stableIterations = (iterationBestMove == lastBestMove) ? stableIterations+1 : 0;
+    lastBestMove = iterationBestMove;
+    lastBestEval = eval;
+    SEARCH_STAT(t.stats.iterations.push_back({curDepth, t.nodes - iterationStartNodes, m_time.getElapsed() - iterationStart_ms,
+      t.iterationBestMove, lastBestMove}));
+    if(verbose) {
+      std::cout << "  depth " << curDepth << " completed after " << m_time.getElapsed() << " ms, " << t.nodes << " nodes";
+      SEARCH_STAT(std::cout << " (" << t.stats.capturesNodes << " in captures search), "
+        << (t.stats.cutoffs ? 100*t.stats.firstMoveCutoffs/t.stats.cutoffs : 0) << "% of cutoffs on the first move");
+      std::cout << "\n";
+    }
+
+    if(lastBestEval > m_inf/2) {
+      // stop as soon as mate reached, at lowest depth possible
+      if(verbose) std::cout << "Minimax found checkmate\n";
+      return lastBestMove;
+    }
 
     curDepth++;
 
+    // don't start an iteration that probably can't finish, and stop sooner the longer the best move has been the same
+    // GROUP C SKILL: simple mathematical calculations
+    if(isMainThread && m_time.isSoftLimitReached(std::max(1.25 - 0.15*stableIterations, 0.5))) break;
+
   }
 
   if(verbose) {
     std::cout << "Depth " << curDepth-1 << "-ply minimax best move:\n";
     Move m = lastBestMove;
-    std::cout << "  " << (char)((m.start&7)+'a') << (m.start>>3)+1
-    << (char)((m.end&7)+'a') << (m.end>>3)+1
+    std::cout << "  " << (char)((m.getStart()&7)+'a') << (m.getStart()>>3)+1
+    << (char)((m.getEnd()&7)+'a') << (m.getEnd()>>3)+1
     << ": " << lastBestEval << "\n";
   }
 
@@ -363,100 +785,61 @@ Move Engine::minimax(int timeLimit_ms, bool verbose) {
 }
 
 int Engine::isGameOver() { // 0 if no, 1 if draw, 2 if checkmate
-    if(m_gen.genMoves(m_pos, false).size()==0)
+    MoveList legalMoves;
+    m_gen.genMoves(m_pos, legalMoves, ALL);
+    if(legalMoves.size()==0)
       return m_gen.getCheckingPieces(m_pos).getBits()==0 ? 1 : 2; 
     return 0;
 }
 
-uint64_t rand64() {
-  return ((long long)rand() << 32) | rand();
+SearchThread::SearchThread() : moveLists(MAX_PLY), quietLists(MAX_PLY), continuationHistory(12*64*12*64, 0) {
+  for(int i=0; i<MAX_PLY; ++i) killers[i][0] = killers[i][1] = Move(0, 0);
+  for(int i=0; i<2; ++i)
+    for(int j=0; j<64; ++j)
+      for(int k=0; k<64; ++k) butterflyHistory[i][j][k] = 0;
+  for(int i=0; i<12; ++i)
+    for(int j=0; j<64; ++j) counterMoves[i][j] = Move(0, 0);
 }
 
-// GROUP B SKILL: simple user-defined algorithms
-void Engine::initZobrist() {
-  // init random numbers
-  for(int i=0; i<12; ++i) {
-    for(int j=0; j<64; ++j) {
-      m_zobristValues[i][j] = rand64();
-    }
-  }
-  m_zobristBlackToMove = rand64();
-  m_zobristWhiteCastleKingside = rand64();
-  m_zobristWhiteCastleQueenside = rand64();
-  m_zobristBlackCastleKingside = rand64();
-  m_zobristBlackCastleQueenside = rand64();
-  for(int i=0; i<8; ++i)
-    m_zobristEnPassant[i] = rand64();
-
-  // calculate zobrist value
-  m_zobrist = 0;
-  for(int i=0; i<64; ++i) {
-    int piece = m_pos.whichPiece(i);
-    if(piece!=empty) m_zobrist ^= m_zobristValues[piece][i];
-  }
-  if(!m_pos.isWhiteToMove()) m_zobrist ^= m_zobristBlackToMove;
-  if(m_pos.canWhiteCastleKingside()) m_zobrist ^= m_zobristWhiteCastleKingside;
-  if(m_pos.canWhiteCastleQueenside()) m_zobrist ^= m_zobristWhiteCastleQueenside;
-  if(m_pos.canBlackCastleKingside()) m_zobrist ^= m_zobristBlackCastleKingside;
-  if(m_pos.canBlackCastleQueenside()) m_zobrist ^= m_zobristBlackCastleQueenside;
-  if(m_pos.getEnPassant()!=0) m_zobrist ^= m_zobristEnPassant[m_pos.getEnPassant().getLsb()&7];
+void SearchThread::ageHeuristics() {
+  for(int i=0; i<MAX_PLY; ++i) killers[i][0] = killers[i][1] = Move(0, 0);
+  for(int i=0; i<2; ++i)
+    for(int j=0; j<64; ++j)
+      for(int k=0; k<64; ++k) butterflyHistory[i][j][k] /= 2;
+  for(int16_t& h : continuationHistory) h /= 2;
 }
 
-// GROUP A SKILL: complex user-defined algorithms
-void Engine::updateZobrist(Move move, int castlingRemovedFlags) {
-  m_zobrist ^= m_zobristValues[move.piece][move.start]; // toggle start square
-  m_zobrist ^= m_zobristValues[move.promotion ? move.promotion : move.piece][move.end]; // toggle end square
-  m_zobrist ^= m_zobristBlackToMove; // toggle side to move
-
-  // if castling, update rook
-  if(move.castle) {
-    switch(move.castle) {
-      case 1:
-        m_zobrist ^= m_zobristValues[wr][7];
-        m_zobrist ^= m_zobristValues[wr][5];
-        break;
-      case 2:
-        m_zobrist ^= m_zobristValues[wr][0];
-        m_zobrist ^= m_zobristValues[wr][3];
-        break;
-      case 3:
-        m_zobrist ^= m_zobristValues[br][63];
-        m_zobrist ^= m_zobristValues[br][61];
-        break;
-      case 4:
-        m_zobrist ^= m_zobristValues[br][56];
-        m_zobrist ^= m_zobristValues[br][59];
-        break;
-    }
-  }
-  // if double pawn push, update en passant
-  if(move.piece==wp && move.end-move.start==16) {
-      m_zobrist ^= m_zobristEnPassant[move.start&7];
-  } else if(move.piece==bp && move.end-move.start==-16) {
-      m_zobrist ^= m_zobristEnPassant[move.start&7];
+// GROUP B SKILL: simple user-defined algorithms
+bool KeyHistory::isRepetition(Position& p) {
+  // only positions with the same side to move, since the last capture or pawn move, can be the same
+  int lookback = std::min({p.getPlysSince50(), count, SIZE});
+  uint64_t key = p.getKey();
+  for(int i=2; i<=lookback; i+=2) {
+    if(keys[(count-i) & (SIZE-1)] == key) return true;
   }
+  return false;
+}
 
-  // update castling rights
-  if(castlingRemovedFlags & 1) m_zobrist ^= m_zobristWhiteCastleKingside;
-  if(castlingRemovedFlags & 2) m_zobrist ^= m_zobristWhiteCastleQueenside;
-  if(castlingRemovedFlags & 4) m_zobrist ^= m_zobristBlackCastleKingside;
-  if(castlingRemovedFlags & 8) m_zobrist ^= m_zobristBlackCastleQueenside;
+// GROUP C SKILL: simple mathematical calculations
+int Engine::scoreToHash(double eval) {
+  if(eval >= m_inf/2) return MATE_SCORE;
+  if(eval <= -m_inf/2) return -MATE_SCORE;
+  return std::clamp((int) std::round(eval*100), -MATE_SCORE+1, MATE_SCORE-1);
 }
 
-// GROUP A SKILL: hashing
-void Engine::writeHash(int depth, double eval, HashType type) {
-  HashTableElement el;
-  el.key = m_zobrist;
-  el.depth = depth;
-  el.eval = eval;
-  el.type = type;
-  m_hashTable[m_zobrist % getHashTableSize()] = el;
+// the static eval of (p), read from (entry) if it was stored there, and (hashHit) says whether (entry) is for (p)
+// note: rounded to centipawns like the stored evals, so that the search doesn't depend on whether it was stored
+double Engine::cachedEval(Position& p, bool hashHit, HashTableEntry& entry) {
+  if(hashHit && entry.eval != HashTableEntry::NO_EVAL) return entry.eval / 100.0;
+  return std::round(eval(p) * 100) / 100.0;
 }
 
-int Engine::getHashTableSize() {
-  return sizeof(m_hashTable) / sizeof(HashTableElement);
+double Engine::scoreFromHash(int score) {
+  if(score == MATE_SCORE) return m_inf;
+  if(score == -MATE_SCORE) return -m_inf;
+  return score / 100.0;
 }
 
 void Engine::outputZobrist() {
-  std::cout << "Zobrist hash of current position: " << m_zobrist << "\n";
+  std::cout << "Zobrist hash of current position: " << m_pos.getKey() << "\n";
 }
@@ -1,36 +1,89 @@
 #include "Position.h"
 #include "Move.h"
 #include "MoveGenerator.h"
+#include "TranspositionTable.h"
+#include "TimeManager.h"
+#include "SearchStats.h"
+#include "MCTSTree.h"
+#include "Random.h"
 #include <vector>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <atomic>
 
 // GROUP B SKILL: simple OOP model
-struct MCTSNode {
+// ring buffer of the keys of the positions before the current one, in the game and then in the search
+// note: only the last getPlysSince50() keys can repeat, so older ones are allowed to be overwritten
+struct KeyHistory {
+  static const int SIZE = 4096; // must be a power of 2
+  // GROUP C SKILL: single-dimensional arrays
+  uint64_t keys[SIZE];
+  int count = 0; // total number of keys pushed, so the newest is at index (count-1) % SIZE
+  void push(uint64_t key) { keys[count++ & (SIZE-1)] = key; }
+  void pop() { count--; }
+  // whether (p) has occurred before, since the last capture or pawn move
+  bool isRepetition(Position& p);
+};
 
-  MCTSNode(Position& pos, Move move);
+// preallocated move list for each ply of the search, so that searching never allocates memory
+// note: (ply) is the distance from the position the search was started from
+const int MAX_PLY = 128;
 
-  // data
-  Position pos;
+// GROUP B SKILL: simple OOP model
+// a legal move from the root position, with what the last search found out about it
+struct RootMove {
   Move move;
-  double score; // sum over all playouts of (0 for loss, 0.5 for draw, 1 for win)
-  double playouts; // number of playouts; so (score/playouts) is win percentage
-
-  // links to other nodes
-  std::vector< std::shared_ptr<MCTSNode> > children;
-  std::shared_ptr<MCTSNode> parent;
-
+  double score; // exact if the move raised alpha in its last search, otherwise -m_inf, since it was only proven no better
+  uint64_t nodes; // size of the move's subtree, which is large when the move was hard to refute
 };
 
-enum HashType {
-  UNKNOWN, LOWER, UPPER, EXACT
+// history scores are kept within +-MAX_HISTORY
+const int MAX_HISTORY = 16384;
+
+// GROUP B SKILL: simple OOP model
+// everything a search thread writes to while searching, so that threads only share the hash table
+struct SearchThread {
+  SearchThread();
+  Position pos;
+  KeyHistory history;
+  std::vector<MoveList> moveLists; // captures (or all moves, at the leaves)
+  std::vector<MoveList> quietLists;
+  std::vector<RootMove> rootMoves; // kept sorted best first between iterations
+  // the last root move to beat alpha in the current iteration, Move(0, 0) if none has yet, and its score
+  Move iterationBestMove;
+  double iterationBestEval;
+  uint64_t nodes = 0; // number of positions searched
+  uint64_t nextTimeCheck = 0; // value of (nodes) at which the clock is next read
+  SearchStats stats;
+  Random rng; // for MCTS, seeded by the engine
+
+  // quiet move ordering heuristics, updated whenever a quiet move causes a cutoff
+  // GROUP B SKILL: multi-dimensional arrays
+  Move killers[MAX_PLY][2]; // the last two quiet moves that caused a cutoff at each ply
+  int butterflyHistory[2][64][64]; // [side to move][start][end], how often the move caused a cutoff
+  Move counterMoves[12][64]; // [piece][end] of the previous move, the quiet move that last refuted it
+  // [piece][end] of the previous move, then [piece][end] of this move, the history of this move as a reply to the previous one
+  // note: 1.2MB, so stored on the heap
+  std::vector<int16_t> continuationHistory;
+  // the histories of every reply to the previous move, indexed by [piece*64 + end]
+  int16_t* getContinuationHistoryRow(PieceType prevPiece, int prevEnd) {
+    return &continuationHistory[(prevPiece*64 + prevEnd)*12*64];
+  }
+  // the move made at each ply, and the piece that made it, so that a position knows the move that led to it
+  Move plyMoves[MAX_PLY];
+  PieceType plyPieces[MAX_PLY];
+  // halves the history scores and clears the killers, so older searches count for less
+  void ageHeuristics();
 };
 
-struct HashTableElement {
-  uint64_t key = 0;
-  int depth = 0;
-  double eval = 0;
-  HashType type = UNKNOWN;
+// GROUP B SKILL: simple OOP model
+// switches for the selective parts of minimax, and MCTS selection's SIMD, so that each can be turned off and benchmarked
+struct SearchOptions {
+  bool nullMovePruning = true;
+  bool lateMoveReductions = true;
+  bool futilityPruning = true; // both reverse futility pruning and futility pruning
+  bool simdSelection = true; // MCTS compares children with AVX2, if the CPU supports it
 };
 
 // GROUP A SKILL - complex OOP
@@ -39,52 +92,110 @@ class Engine {
   public:
     Engine();
     Engine(std::string FEN);
+    // sets the current position (starting a new game), keeping the hash table size
+    void setPosition(std::string FEN);
+    // resizes (and clears) the hash table
+    // returns false, keeping the old table, if there isn't enough memory
+    bool setHashSize(int sizeMB);
+    int getHashSize();
+    // number of threads minimax (lazy SMP) and MCTS (shared tree) search with, at least 1
+    void setThreads(int threads);
+    int getThreads();
+    // reseeds the random numbers of every thread, so that MCTS makes the same choices for the same seed
+    // note: runs are only repeatable with 1 thread, since threads share the tree
+    void setSeed(uint64_t seed);
+    uint64_t getSeed();
+    void setSearchOptions(SearchOptions options);
+    SearchOptions getSearchOptions();
     void makeMove(Move move);
     Move MCTS(int timeLimit_ms, bool alphaBeta, bool verbose);
+    // searches for a fixed time
     Move minimax(int timeLimit_ms, bool verbose);
+    // searches for a share of the clock, see TimeManager::startClock
+    Move minimax(int time_ms, int increment_ms, int movesToGo, bool verbose);
+    // statistics of the last minimax search, with every thread's counters added up (all zero if compiled with NO_SEARCH_STATS)
+    SearchStats getSearchStats();
     Position getPos();
-    std::vector<Move> getLegalMoves();
+    MoveList getLegalMoves();
     int isGameOver(); // 0 for no, 1 for draw, 2 for checkmate
     void outputZobrist();
 
   private:
     Position m_pos;
     MoveGenerator m_gen;
-    std::shared_ptr<MCTSNode> m_root;
-
-    void doOneMonteCarloStep(bool alphaBeta, std::chrono::time_point<std::chrono::steady_clock> startTime_ms);
-    double playout(Position& p);
+    // rooted at m_pos, and shared by every MCTS thread
+    static const int DEFAULT_MCTS_MB = 64;
+    MCTSTree m_tree;
+
+    void doOneMonteCarloStep(SearchThread& t, bool alphaBeta);
+    double playout(SearchThread& t);
+
+    // the search functions work on (t.pos), making and unmaking moves in place
+    double minimaxAB(SearchThread& t, int ply, int depth, double alpha, double beta);
+    double capturesAB(SearchThread& t, int ply, double alpha, double beta);
+    // searches every root move with (alpha, beta), then sorts t.rootMoves best first
+    double searchRoot(SearchThread& t, int depth, double alpha, double beta);
+    // iterative deepening from (t.pos), starting at (startDepth), returns the best move of the deepest completed search
+    Move iterativeDeepening(SearchThread& t, int startDepth, bool verbose);
+
+    // searches until m_time stops it
+    Move minimax(bool verbose);
+    TimeManager m_time;
+    static const int TIME_CHECK_NODES = 1024;
+
+    // lazy SMP: every thread runs its own iterative deepening, and they help each other through the shared hash table
+    // threads[0] is the main thread, whose result is used
+    // MCTS also runs on every thread, all sharing one tree (tree parallelisation)
+    std::vector< std::unique_ptr<SearchThread> > m_threads;
+    uint64_t m_seed = Random::DEFAULT_SEED; // thread i is seeded with (m_seed + i)
+    // set when the main thread finishes, so that the helper threads stop
+    std::atomic<bool> m_stop{false};
+    bool isTimeUp(SearchThread& t);
+
+    // rewards the quiet (move), which caused a cutoff, and punishes the quiet moves tried before it
+    void updateQuietHeuristics(SearchThread& t, int ply, int depth, Move move, MoveList& quietsTried);
 
-    double minimaxAB(Position& p, std::chrono::time_point<std::chrono::steady_clock> startTime_ms, int timeLimit_ms, int depth, double alpha, double beta);
-    double capturesAB(Position& p, std::chrono::time_point<std::chrono::steady_clock> startTime_ms, int timeLimit_ms, double alpha, double beta);
-
-    void order(Position& p, std::vector<Move>& moves);
     double eval(Position& p);
+    // whether the side to move has a piece other than pawns and the king, when zugzwang is unlikely
+    bool hasNonPawnMaterial(Position& p);
 
     double m_inf = 100000000;
+    // width of the window used to prove a move is no better than the best so far (principal variation search)
+    double m_nullWindow = 0.01;
+    // initial half-width of the window around the previous iteration's score (aspiration windows)
+    double m_aspirationWindow = 0.25;
+
+    SearchStats m_searchStats; // of the last minimax search
+
+    // selective search
+    SearchOptions m_options;
+    // null move searches are reduced by NULL_MOVE_REDUCTION, plus one ply for every 4 plies of depth
+    static const int NULL_MOVE_REDUCTION = 2;
+    // futility pruning is only done this close to the leaves, where the static eval is trustworthy
+    static const int FUTILITY_DEPTH = 3;
+    // how far (per ply of depth) the static eval must be from the window before it is assumed to stay there
+    double m_futilityMargin = 1.0;
+    // the most a capture is assumed to change the eval by, other than the material it wins (delta pruning)
+    double m_deltaMargin = 2.0;
+    // GROUP B SKILL: multi-dimensional arrays
+    // late move reductions, indexed by [depth][number of moves already searched]
+    int m_reductions[64][64];
+    void initReductions();
     // GROUP C SKILL: single dimensional arrays
     double m_pieceValues[12] = {1, 3, 3, 5, 9, 0, 1, 3, 3, 5, 9, 0}; // wp, wn, wb, etc (kings n/a)
     double m_centreDist[8] = {3, 2, 1, 0, 0, 1, 2, 3}; // distance to centre for each file/rank
 
     // transposition table
-    void initZobrist();
-    void updateZobrist(Move move, int castlingRemovedFlags);
-    void writeHash(int depth, double eval, HashType type);
-    // GROUP C SKILL: simple data types
-    uint64_t m_zobrist;
-    int getHashTableSize();
-    HashTableElement m_hashTable[10000];
-
-    // pseudorandom numbers
-    // GROUP B SKILL: multi-dimensional arrays
-    uint64_t m_zobristValues[12][64]; // each piece at each square
-    uint64_t m_zobristBlackToMove;
-    uint64_t m_zobristWhiteCastleKingside;
-    uint64_t m_zobristWhiteCastleQueenside;
-    uint64_t m_zobristBlackCastleKingside;
-    uint64_t m_zobristBlackCastleQueenside;
-    uint64_t m_zobristEnPassant[8]; // each of the 8 files
-
-    std::vector<Position> m_prevPositions;
+    // note: positions are hashed by Position itself, see Position::getKey
+    static const int DEFAULT_HASH_MB = 16;
+    TranspositionTable m_tt;
+    // scores are stored as integer centipawns, with mates stored as +-MATE_SCORE
+    static const int MATE_SCORE = 32000;
+    int scoreToHash(double eval);
+    double scoreFromHash(int score);
+    double cachedEval(Position& p, bool hashHit, HashTableEntry& entry);
+
+    // keys of the positions played in the game before the current one
+    KeyHistory m_history;
 
 };
@@ -0,0 +1,168 @@
+#include "MCTSTree.h"
+#include "Move.h"
+#include <cstdint>
+#include <atomic>
+#include <math.h>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// GROUP C SKILL: simple mathematical calculations
+// the UCT value of each child is w_i/n_i + sqrt(c*ln(n_{i-1})/n_i), where (exploration) is the c*ln(n_{i-1}) term,
+// the same for every child, and c is an adjustable constant to control the exploitation / exploration ratio
+// returns the offset of the child with the largest value, the first of them if several are equal
+// note: 0.000001 is added to n_i since dividing by 0 is undefined
+static int selectScalar(const std::atomic<double>* scores, const std::atomic<uint32_t>* playouts, int count, double exploration) {
+  int best = 0;
+  double maxVal = -1;
+  for(int i=0; i<count; ++i) {
+    double childPlayouts = playouts[i].load(std::memory_order_relaxed) + 0.000001;
+    double val = scores[i].load(std::memory_order_relaxed) / childPlayouts + sqrt(exploration / childPlayouts);
+    if(val>maxVal) {
+      maxVal = val;
+      best = i;
+    }
+  }
+  return best;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// same as selectScalar, 4 children at a time
+// compiled for AVX2 even if the rest of the program isn't, and only ever called if the CPU supports it
+// note: reads the atomic statistics as plain numbers, which on x86 is what a relaxed load does anyway,
+//       and a value another thread is updating is at worst one playout out of date, so the thread sanitizer skips it
+__attribute__((target("avx2"), no_sanitize("thread"))) static int selectAvx2(const double* scores, const uint32_t* playouts, int count, double exploration) {
+  const __m256d epsilon = _mm256_set1_pd(0.000001);
+  const __m256d explorationVec = _mm256_set1_pd(exploration);
+  const __m256d four = _mm256_set1_pd(4);
+  // the best value and offset seen in each lane
+  __m256d bestVal = _mm256_set1_pd(-1);
+  __m256d bestIndex = _mm256_setzero_pd();
+  __m256d index = _mm256_set_pd(3, 2, 1, 0);
+  int i = 0;
+  for(; i+4<=count; i+=4) {
+    __m256d childPlayouts = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*) (playouts+i))), epsilon);
+    __m256d val = _mm256_add_pd(_mm256_div_pd(_mm256_loadu_pd(scores+i), childPlayouts),
+                                _mm256_sqrt_pd(_mm256_div_pd(explorationVec, childPlayouts)));
+    __m256d better = _mm256_cmp_pd(val, bestVal, _CMP_GT_OQ);
+    bestVal = _mm256_blendv_pd(bestVal, val, better);
+    bestIndex = _mm256_blendv_pd(bestIndex, index, better);
+    index = _mm256_add_pd(index, four);
+  }
+
+  // combine the lanes, taking the first child on a tie, as selectScalar does
+  double vals[4], indices[4];
+  _mm256_storeu_pd(vals, bestVal);
+  _mm256_storeu_pd(indices, bestIndex);
+  double maxVal = vals[0];
+  int best = (int) indices[0];
+  for(int lane=1; lane<4; ++lane) {
+    if(vals[lane] > maxVal || (vals[lane] == maxVal && indices[lane] < best)) {
+      maxVal = vals[lane];
+      best = (int) indices[lane];
+    }
+  }
+
+  // the last few children, which come after all the others
+  for(; i<count; ++i) {
+    double childPlayouts = playouts[i] + 0.000001;
+    double val = scores[i] / childPlayouts + sqrt(exploration / childPlayouts);
+    if(val>maxVal) {
+      maxVal = val;
+      best = i;
+    }
+  }
+  return best;
+}
+#else
+// unreachable, since AVX2 is never supported off x86
+static int selectAvx2(const double* scores, const uint32_t* playouts, int count, double exploration) {
+  return 0;
+}
+#endif
+
+void MCTSNode::init(Move move, uint32_t parent) {
+  this->parent = parent;
+  firstChild.store(MCTSTree::NO_NODE, std::memory_order_relaxed);
+  this->move = move;
+  numChildren = 0;
+}
+
+MCTSTree::MCTSTree(int sizeMB) {
+  m_capacity = ((uint64_t) sizeMB << 20) / (sizeof(MCTSNode) + sizeof(double) + sizeof(uint32_t));
+  m_nodes.reset(new MCTSNode[m_capacity]);
+  m_scores.reset(new std::atomic<double>[m_capacity]);
+  m_playouts.reset(new std::atomic<uint32_t>[m_capacity]);
+#if defined(__x86_64__) || defined(_M_X64)
+  m_simdSupported = __builtin_cpu_supports("avx2");
+#else
+  m_simdSupported = false;
+#endif
+  m_useSimd = m_simdSupported;
+  reset(Move(0, 0)); // dummy move
+}
+
+void MCTSTree::reset(Move move) {
+  m_nodes[0].init(move, NO_NODE);
+  m_scores[0].store(0, std::memory_order_relaxed);
+  m_playouts[0].store(0, std::memory_order_relaxed);
+  m_size.store(1, std::memory_order_relaxed);
+  m_full.store(false, std::memory_order_relaxed);
+}
+
+uint32_t MCTSTree::allocate(int count) {
+  uint32_t first = m_size.load(std::memory_order_relaxed);
+  do {
+    if(first + count > m_capacity) {
+      m_full.store(true, std::memory_order_relaxed);
+      return NO_NODE;
+    }
+  } while(!m_size.compare_exchange_weak(first, first + count, std::memory_order_relaxed));
+  return first;
+}
+
+// GROUP A SKILL: complex user-defined algorithms
+// the thread that changes (firstChild) from NO_NODE to EXPANDING adds the children, and publishes them by storing
+// the real index with release ordering, so that a thread that reads it with acquire ordering sees every child
+uint32_t MCTSTree::expand(uint32_t parent, MoveList& moves) {
+  MCTSNode& node = m_nodes[parent];
+  uint32_t expected = NO_NODE;
+  if(!node.firstChild.compare_exchange_strong(expected, EXPANDING, std::memory_order_acquire)) return NO_NODE;
+  uint32_t first = allocate(moves.size());
+  if(first == NO_NODE) {
+    node.firstChild.store(NO_NODE, std::memory_order_relaxed);
+    return NO_NODE;
+  }
+  for(int i=0; i<moves.size(); ++i) {
+    m_nodes[first+i].init(moves[i], parent);
+    m_scores[first+i].store(0, std::memory_order_relaxed);
+    m_playouts[first+i].store(0, std::memory_order_relaxed);
+  }
+  node.numChildren = moves.size();
+  node.firstChild.store(first, std::memory_order_release);
+  return first;
+}
+
+// atomic<double> has no fetch_add before C++20, so add with a compare-exchange loop
+void MCTSTree::addScore(uint32_t index, double result) {
+  std::atomic<double>& score = m_scores[index];
+  double old = score.load(std::memory_order_relaxed);
+  while(!score.compare_exchange_weak(old, old+result, std::memory_order_relaxed));
+}
+
+uint32_t MCTSTree::selectChild(uint32_t parent, uint32_t firstChild) {
+  // the parent's term is worked out once, instead of once per child
+  double exploration = 2*log2(m_playouts[parent].load(std::memory_order_relaxed));
+  int count = m_nodes[parent].numChildren;
+  if(m_useSimd) {
+    return firstChild + selectAvx2(reinterpret_cast<const double*>(&m_scores[firstChild]),
+                                   reinterpret_cast<const uint32_t*>(&m_playouts[firstChild]), count, exploration);
+  }
+  return firstChild + selectScalar(&m_scores[firstChild], &m_playouts[firstChild], count, exploration);
+}
+
+bool MCTSTree::setUseSimd(bool useSimd) {
+  if(useSimd && !m_simdSupported) return false;
+  m_useSimd = useSimd;
+  return true;
+}
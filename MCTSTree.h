@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Move.h"
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+// GROUP B SKILL: simple OOP model
+// the links of a node, whose statistics are kept by the tree, see MCTSTree
+// a node only stores the move leading to it, and its position is rebuilt by playing the moves from the root
+struct MCTSNode {
+
+  // links to other nodes, as indices into the tree's arena
+  uint32_t parent; // MCTSTree::NO_NODE for the root
+  // the children are stored next to each other, from here
+  // MCTSTree::NO_NODE if not expanded yet, or MCTSTree::EXPANDING while a thread is adding them
+  // note: atomic since the tree is shared by every MCTS thread
+  std::atomic<uint32_t> firstChild;
+  Move move;
+  uint16_t numChildren; // only valid once (firstChild) is
+
+  void init(Move move, uint32_t parent);
+
+};
+
+// GROUP A SKILL: complex OOP
+// every node of a Monte Carlo tree, stored in one contiguous arena and linked by 32-bit indices
+// so selection walks nearby memory, and the whole tree is freed at once instead of node by node
+// the statistics are kept in their own arrays (structure of arrays), so the children of a node, which are contiguous,
+// have their scores and playouts next to each other, ready to be compared several at a time with SIMD
+// note: nodes are never moved or freed during a search, so threads can expand the tree at the same time without locks
+class MCTSTree {
+
+  public:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+    static constexpr uint32_t EXPANDING = UINT32_MAX-1;
+
+    // allocates the largest number of nodes that fits in (sizeMB)
+    MCTSTree(int sizeMB);
+    // removes every node and adds a root, reached by (move)
+    // note: constant time, and mustn't be called during a search
+    void reset(Move move);
+    uint32_t getRoot() const { return 0; }
+    MCTSNode& getNode(uint32_t index) { return m_nodes[index]; }
+    // sum over all playouts of (0 for loss, 0.5 for draw, 1 for win)
+    std::atomic<double>& getScore(uint32_t index) { return m_scores[index]; }
+    // number of playouts; so (score/playouts) is win percentage
+    // note: counted when a thread passes through on the way down, and the score added on the way back up,
+    //       so that a playout in progress counts as a loss (virtual loss), and other threads try other nodes
+    std::atomic<uint32_t>& getPlayouts(uint32_t index) { return m_playouts[index]; }
+    void addScore(uint32_t index, double result);
+    int size() const { return m_size.load(std::memory_order_relaxed); }
+    // whether an expansion has failed for lack of room, so the tree stopped growing
+    bool isFull() const { return m_full.load(std::memory_order_relaxed); }
+    // adds a child of (parent) for each of (moves), stored contiguously, and returns the index of the first
+    // returns NO_NODE instead if another thread got to (parent) first, or there is no room left
+    // note: a child is just its move and empty statistics, no position is made until the child is visited
+    uint32_t expand(uint32_t parent, MoveList& moves);
+    // the child of (parent), whose children start at (firstChild), with the highest UCT value
+    uint32_t selectChild(uint32_t parent, uint32_t firstChild);
+
+    // selection compares 4 children at a time with AVX2 if the CPU supports it, else one at a time
+    bool isSimdSupported() const { return m_simdSupported; }
+    bool getUseSimd() const { return m_useSimd; }
+    // returns false (and changes nothing) when asked to use SIMD on a CPU without AVX2
+    bool setUseSimd(bool useSimd);
+
+  private:
+    // GROUP C SKILL: single-dimensional arrays
+    std::unique_ptr<MCTSNode[]> m_nodes;
+    std::unique_ptr<std::atomic<double>[]> m_scores;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_playouts;
+    uint32_t m_capacity;
+    std::atomic<uint32_t> m_size;
+    std::atomic<bool> m_full;
+    bool m_simdSupported;
+    bool m_useSimd;
+    // reserves (count) contiguous nodes, returning the index of the first, or NO_NODE if they don't fit
+    uint32_t allocate(int count);
+
+};
+
+static_assert(std::is_trivially_destructible<MCTSNode>::value, "clearing the arena shouldn't have to visit every node");
+static_assert(sizeof(MCTSNode) + sizeof(double) + sizeof(uint32_t) == 24, "a tree node should be 24 bytes");
+// the SIMD selection reads the statistics as plain doubles and integers
+static_assert(sizeof(std::atomic<double>) == sizeof(double) && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+  "atomic statistics should have the same layout as plain ones");
@@ -1,19 +1,79 @@
 #pragma once
 
-enum PieceType {
+#include <cstdint>
+
+// note: stored in one byte, so that a Position's board is 64 bytes
+enum PieceType : uint8_t {
   wp, wn, wb, wr, wq, wk,
   bp, bn, bb, br, bq, bk,
   empty
 };
 
+// special move flags, stored in the top two bits of a Move
+enum MoveType {
+  NORMAL, PROMOTION, EN_PASSANT, CASTLING
+};
+
 // GROUP B SKILL: simple OOP
-struct Move {
-    Move(int start, int end, int piece, int castle, int promotion, bool enPassant)
-      : start(start), end(end), piece(piece), castle(castle), promotion(promotion), enPassant(enPassant) {};
-    int start;
-    int end;
-    int piece;
-    int castle; // 0 for no, 1 for white kingside castle, 2 for white queenside, etc
-    int promotion; // 0 (false) if not a pawn promotion move, else it is one of (wn,wb,wr,wq,wk, bn,bb,br,bq,bk)
-    bool enPassant;
+// a move packed into 16 bits, so that move lists, hash table entries and tree nodes stay small:
+//   bits 0-5   start square
+//   bits 6-11  end square
+//   bits 12-13 promotion piece (0 knight, 1 bishop, 2 rook, 3 queen), only meaningful if a promotion
+//   bits 14-15 MoveType
+// the piece being moved isn't stored, it is read from the position the move is played in
+class Move {
+  public:
+    Move() {}; // uninitialised, so that a MoveList can be declared without touching every entry
+    Move(int start, int end) : m_data(start | end<<6) {};
+    // (promotion) is one of (wn,wb,wr,wq, bn,bb,br,bq), ignored unless type is PROMOTION
+    Move(int start, int end, MoveType type, int promotion = wn)
+      : m_data(start | end<<6 | (type==PROMOTION ? (promotion%6 - wn)<<12 : 0) | type<<14) {};
+
+    int getStart() { return m_data & 63; }
+    int getEnd() { return (m_data>>6) & 63; }
+    MoveType getType() { return (MoveType) (m_data>>14); }
+    bool isEnPassant() { return getType() == EN_PASSANT; }
+    // 0 (false) if not a pawn promotion move, else it is one of (wn,wb,wr,wq, bn,bb,br,bq)
+    // note: the colour is known from the end square, since white can only promote on the eighth rank
+    int getPromotion() {
+      if(getType() != PROMOTION) return 0;
+      return wn + ((m_data>>12)&3) + (getEnd()<8 ? 6 : 0);
+    }
+    // 0 for no, 1 for white kingside castle, 2 for white queenside, 3 for black kingside, 4 for black queenside
+    int getCastle() {
+      if(getType() != CASTLING) return 0;
+      int end = getEnd();
+      return (end==6) ? 1 : (end==2) ? 2 : (end==62) ? 3 : 4;
+    }
+    uint16_t getData() { return m_data; }
+    static Move fromData(uint16_t data) { Move move; move.m_data = data; return move; }
+
+    bool operator== (Move op) { return m_data == op.getData(); }
+    bool operator!= (Move op) { return m_data != op.getData(); }
+
+  private:
+    // GROUP C SKILL: simple data types
+    uint16_t m_data;
+};
+
+// the most legal moves in any reachable position is 218, so 256 is always enough
+const int MAX_MOVES = 256;
+
+// GROUP B SKILL: simple OOP
+// fixed-capacity list of moves, intended to live on the stack (or in a preallocated search stack)
+// so that move generation never allocates memory
+class MoveList {
+  public:
+    MoveList() : m_size(0) {};
+    void push_back(Move move) { m_moves[m_size++] = move; }
+    void clear() { m_size = 0; }
+    int size() { return m_size; }
+    Move& operator[] (int i) { return m_moves[i]; }
+    Move* begin() { return m_moves; }
+    Move* end() { return m_moves + m_size; }
+
+  private:
+    // GROUP C SKILL: single-dimensional arrays
+    Move m_moves[MAX_MOVES];
+    int m_size;
 };
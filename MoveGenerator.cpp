@@ -2,12 +2,51 @@
 #include "Position.h"
 #include "Move.h"
 #include "Bitboard.h"
+#include "Random.h"
 #include <iostream>
 #include <string>
-#include <random>
-#include <vector>
+#include <algorithm>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+// compiled for BMI2 even if the rest of the program isn't, and only ever called if the CPU supports it
+__attribute__((target("bmi2"))) static uint64_t pext(uint64_t bits, uint64_t mask) {
+  return _pext_u64(bits, mask);
+}
+#else
+// unreachable, since PEXT is never supported off x86
+static uint64_t pext(uint64_t bits, uint64_t mask) {
+  return 0;
+}
+#endif
+
+// storage for the shared lookup tables
+std::once_flag MoveGenerator::m_tablesInitialised;
+Bitboard MoveGenerator::m_bishopPushMasks[64][64];
+Bitboard MoveGenerator::m_rookPushMasks[64][64];
+Bitboard MoveGenerator::m_knightMoves[64];
+Bitboard MoveGenerator::m_kingMoves[64];
+Bitboard MoveGenerator::m_rookMasks[64];
+int MoveGenerator::m_rookShifts[64];
+int MoveGenerator::m_rookOffsets[64];
+Bitboard MoveGenerator::m_rookMoves[ROOK_TABLE_SIZE];
+Bitboard MoveGenerator::m_bishopMasks[64];
+int MoveGenerator::m_bishopShifts[64];
+int MoveGenerator::m_bishopOffsets[64];
+Bitboard MoveGenerator::m_bishopMoves[BISHOP_TABLE_SIZE];
+bool MoveGenerator::m_pextSupported;
+Bitboard MoveGenerator::m_rookPextMoves[ROOK_TABLE_SIZE];
+Bitboard MoveGenerator::m_bishopPextMoves[BISHOP_TABLE_SIZE];
 
 MoveGenerator::MoveGenerator() {
+  // only the first generator in the process pays for building the tables
+  std::call_once(m_tablesInitialised, initTables);
+  m_usePext = m_pextSupported;
+}
+
+void MoveGenerator::initTables() {
 
   initKnightMoveTable();
   initKingMoveTable();
@@ -17,9 +56,23 @@ MoveGenerator::MoveGenerator() {
   initRookBishopBlockerMasks(true); // rook move masks
   initRookBishopBlockerMasks(false); // bishop move masks
 
+  initRookBishopOffsets(true); // rook table layout
+  initRookBishopOffsets(false); // bishop table layout
+
   initRookBishopMoveTable(true);  // rook move table
   initRookBishopMoveTable(false); // bishop move table
 
+  // choose the sliding piece backend based on the CPU
+#if defined(__x86_64__) || defined(_M_X64)
+  m_pextSupported = __builtin_cpu_supports("bmi2");
+#else
+  m_pextSupported = false;
+#endif
+  if(m_pextSupported) {
+    initRookBishopPextTable(true);  // rook PEXT table
+    initRookBishopPextTable(false); // bishop PEXT table
+  }
+
   //findRookBishopMagics(true); // rook magics
   //findRookBishopMagics(false); // bishop magics
 
@@ -170,84 +223,170 @@ Bitboard MoveGenerator::getRookBishopMoveBoard(bool isRook, Bitboard blockerBoar
 }
 
 // GROUP A SKILL: complex user-defined algorithms
+// finds a "fancy" magic number for each square, which hashes its blocker configurations into exactly as many
+// indices as there are potential blockers on that square (e.g. 2^6 for a bishop in the corner), then prints them
 void MoveGenerator::findRookBishopMagics(bool isRook) {
   std::cout << "finding magics...\n";
-  // number of bits needed to store all possible blocker configurations, which equals the max number of potential blockers
-  int bits = (isRook ? 12 : 9); // a rook has at most 12 potential blockers, bishop has at most 9
-  int size = 1<<bits; // at most 2^bits possible blocker configurations: i.e. 4096 for rook, 512 for bishop
 
+  Random rng;
   // GROUP A SKILL: hashing
-  // generate all possible blocker configurations
   for(int i=0; i<64; ++i) {
+    // number of bits needed to store all possible blocker configurations, which equals the number of potential blockers
+    Bitboard mask = isRook ? m_rookMasks[i] : m_bishopMasks[i];
+    int bits = mask.popcnt();
+    int size = 1<<bits;
+
+    // generate all possible blocker configurations, and the moves for each
+    Bitboard blockerBoards[4096];
+    Bitboard moveBoards[4096];
+    for(int j=0; j<size; ++j) {
+      blockerBoards[j] = getBlockerBoard(mask, j);
+      moveBoards[j] = getRookBishopMoveBoard(isRook, blockerBoards[j], i);
+    }
+
     // try magic numbers until one works i.e. hashes with no collisions
+    Bitboard moveTable[4096];
+    bool used[4096];
     while(true) {
       // generate a random magic bitboard with a low density of 1s
-      // note: assumes std::rand is 32-bit
-      Bitboard random1 = ((long long)rand() << 32) | rand();
-      Bitboard random2 = ((long long)rand() << 32) | rand();
-      Bitboard random3 = ((long long)rand() << 32) | rand();
-      Bitboard trialNum = random1 & random2 & random3;
+      Bitboard trialNum = rng.nextSparse();
 
       bool fail = false;
-      Bitboard moveTable[size];
-      bool used[size];
       for(int j=0; j<size; ++j) {
         used[j] = false;
       }
       for(int j=0; j<size; ++j) {
-        Bitboard blockerBoard = getBlockerBoard(isRook ? m_rookMasks[i] : m_bishopMasks[i], j);
-        int index = (trialNum.getBits() * blockerBoard.getBits()) >> (64 - bits); // use first 12 (if rook, 9 if bishop) bits as magic index
-        Bitboard moveBoard = getRookBishopMoveBoard(isRook, blockerBoard, i);
+        int index = (trialNum.getBits() * blockerBoards[j].getBits()) >> (64 - bits); // use the first (bits) bits as magic index
         // if two blocker boards generate the same magic index but different move boards, then fail
-        if(used[index] && moveBoard != moveTable[index]) {
+        if(used[index] && moveBoards[j] != moveTable[index]) {
           fail = true;
           break;
         } else {
           used[index] = true;
-          moveTable[index] = moveBoard;
+          moveTable[index] = moveBoards[j];
         }
       }
       if(!fail) {
-        std::cout << trialNum.getBits() << "\n";
+        std::cout << "      " << trialNum.getBits() << ",\n";
         break;
       }
     }
 
-  }  
+  }
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+// calculate the shift and table offset for each square, which both backends share
+void MoveGenerator::initRookBishopOffsets(bool isRook) {
+  int offset = 0;
+  // for each square
+  for(int i=0; i<64; ++i) {
+    // number of bits needed to store all possible blocker configurations, which equals the number of potential blockers
+    int bits = (isRook ? m_rookMasks[i] : m_bishopMasks[i]).popcnt();
+    if(isRook) {
+      m_rookShifts[i] = 64 - bits;
+      m_rookOffsets[i] = offset;
+    } else {
+      m_bishopShifts[i] = 64 - bits;
+      m_bishopOffsets[i] = offset;
+    }
+    offset += 1<<bits;
+  }
 }
 
 // GROUP B SKILL: simple user-defined algorithms
 void MoveGenerator::initRookBishopMoveTable(bool isRook) {
-  // number of bits needed to store all possible blocker configurations, which equals the max number of potential blockers
-  int bits = (isRook ? 12 : 9); // a rook has at most 12 potential blockers, bishop has at most 9
-  int size = 1<<bits; // at most 2^bits possible blocker configurations: i.e. 4096 for rook, 512 for bishop
-  
   // for each square
   for(int i=0; i<64; ++i) {
+    Bitboard mask = isRook ? m_rookMasks[i] : m_bishopMasks[i];
     Bitboard magicNum = isRook ? m_rookMagics[i] : m_bishopMagics[i];
+    int shift = isRook ? m_rookShifts[i] : m_bishopShifts[i];
+    int offset = isRook ? m_rookOffsets[i] : m_bishopOffsets[i];
     // for every blocker configuration
-    for(int j=0; j<size; ++j) {
-      Bitboard blockerBoard = getBlockerBoard(isRook ? m_rookMasks[i] : m_bishopMasks[i], j);
+    for(int j=0; j < (1<<mask.popcnt()); ++j) {
+      Bitboard blockerBoard = getBlockerBoard(mask, j);
 
-      int index = (magicNum.getBits() * blockerBoard.getBits()) >> (64 - bits); // magic index
+      int index = offset + ((magicNum.getBits() * blockerBoard.getBits()) >> shift); // magic index
       Bitboard moveBoard = getRookBishopMoveBoard(isRook, blockerBoard, i);
       // write to the table
-      if(isRook) m_rookMoves[i][index] = moveBoard;
-      else m_bishopMoves[i][index] = moveBoard;
+      if(isRook) m_rookMoves[index] = moveBoard;
+      else m_bishopMoves[index] = moveBoard;
+    }
+  }
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+void MoveGenerator::initRookBishopPextTable(bool isRook) {
+  Bitboard* table = isRook ? m_rookPextMoves : m_bishopPextMoves;
+  // for each square
+  for(int i=0; i<64; ++i) {
+    Bitboard mask = isRook ? m_rookMasks[i] : m_bishopMasks[i];
+    int offset = isRook ? m_rookOffsets[i] : m_bishopOffsets[i];
+    // for every blocker configuration
+    // note: the j-th blocker board has PEXT index j, since both distribute bits in order of increasing square
+    for(int j=0; j < (1<<mask.popcnt()); ++j) {
+      table[offset + j] = getRookBishopMoveBoard(isRook, getBlockerBoard(mask, j), i);
     }
   }
 }
 
+bool MoveGenerator::isPextSupported() {
+  return m_pextSupported;
+}
+
+bool MoveGenerator::isUsingPext() {
+  return m_usePext;
+}
+
+bool MoveGenerator::setUsePext(bool usePext) {
+  if(usePext && !m_pextSupported) return false;
+  m_usePext = usePext;
+  return true;
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+bool MoveGenerator::verifySliderBackends() {
+  if(!m_pextSupported) return true;
+  for(int i=0; i<64; ++i) {
+    // try every blocker configuration for both piece types
+    for(int j=0; j < (1<<m_rookMasks[i].popcnt()); ++j) {
+      Bitboard blockerBoard = getBlockerBoard(m_rookMasks[i], j);
+      if(rookMagicMoves(i, blockerBoard) != rookPextMoves(i, blockerBoard)) return false;
+    }
+    for(int j=0; j < (1<<m_bishopMasks[i].popcnt()); ++j) {
+      Bitboard blockerBoard = getBlockerBoard(m_bishopMasks[i], j);
+      if(bishopMagicMoves(i, blockerBoard) != bishopPextMoves(i, blockerBoard)) return false;
+    }
+  }
+  return true;
+}
+
 Bitboard MoveGenerator::rookMoves(int square, Bitboard occupancy) {
-  Bitboard blockerBoard = occupancy & m_rookMasks[square];
-  Bitboard index = (m_rookMagics[square] * blockerBoard) >> (64 - 12);
-  return m_rookMoves[square][index.getBits()];
+  return m_usePext ? rookPextMoves(square, occupancy) : rookMagicMoves(square, occupancy);
 }
 
 Bitboard MoveGenerator::bishopMoves(int square, Bitboard occupancy) {
+  return m_usePext ? bishopPextMoves(square, occupancy) : bishopMagicMoves(square, occupancy);
+}
+
+Bitboard MoveGenerator::rookMagicMoves(int square, Bitboard occupancy) {
+  Bitboard blockerBoard = occupancy & m_rookMasks[square];
+  Bitboard index = (m_rookMagics[square] * blockerBoard) >> m_rookShifts[square];
+  return m_rookMoves[m_rookOffsets[square] + index.getBits()];
+}
+
+Bitboard MoveGenerator::bishopMagicMoves(int square, Bitboard occupancy) {
   Bitboard blockerBoard = occupancy & m_bishopMasks[square];
-  Bitboard index = (m_bishopMagics[square] * blockerBoard) >> (64 - 9);
-  return m_bishopMoves[square][index.getBits()];
+  Bitboard index = (m_bishopMagics[square] * blockerBoard) >> m_bishopShifts[square];
+  return m_bishopMoves[m_bishopOffsets[square] + index.getBits()];
+}
+
+Bitboard MoveGenerator::rookPextMoves(int square, Bitboard occupancy) {
+  return m_rookPextMoves[m_rookOffsets[square] + pext(occupancy.getBits(), m_rookMasks[square].getBits())];
+}
+
+Bitboard MoveGenerator::bishopPextMoves(int square, Bitboard occupancy) {
+  return m_bishopPextMoves[m_bishopOffsets[square] + pext(occupancy.getBits(), m_bishopMasks[square].getBits())];
 }
 
 Bitboard MoveGenerator::queenMoves(int square, Bitboard occupancy) {
@@ -256,7 +395,8 @@ Bitboard MoveGenerator::queenMoves(int square, Bitboard occupancy) {
 }
 
 // GROUP B SKILL: simple user-defined algorithms
-Bitboard MoveGenerator::pawnPushes(Bitboard pawns, bool isWhite, Bitboard occupancy) {
+template<bool isWhite>
+Bitboard MoveGenerator::pawnPushes(Bitboard pawns, Bitboard occupancy) {
   // bitwise shift by +-8 to get places the pawns could advance to
   Bitboard moves = isWhite ? pawns<<8 : pawns>>8;
   moves &= ~occupancy; // can't push to occupied square
@@ -268,7 +408,8 @@ Bitboard MoveGenerator::pawnPushes(Bitboard pawns, bool isWhite, Bitboard occupa
   return moves;
 }
 
-Bitboard MoveGenerator::pawnAttacks(Bitboard pawns, bool isWhite) {
+template<bool isWhite>
+Bitboard MoveGenerator::pawnAttacks(Bitboard pawns) {
   // bitwise shift left by 7 (or -9 if black) to get the captures to the left
   Bitboard leftAttacks = isWhite ? pawns<<7 : pawns>>9;
   leftAttacks &= notHFile; // a left capture can't be on the H file, fixes wraparound issues
@@ -285,273 +426,378 @@ Bitboard MoveGenerator::enPassantCaptures(Bitboard pawns) {
   return left | right;
 }
 
+// pseudo-legal moves of a non-pawn piece of type (pt), which is given as the white piece type
+template<PieceType pt>
+Bitboard MoveGenerator::pieceMoves(int square, Bitboard occupancy) {
+  if constexpr (pt == wn) return m_knightMoves[square];
+  else if constexpr (pt == wb) return bishopMoves(square, occupancy);
+  else if constexpr (pt == wr) return rookMoves(square, occupancy);
+  else if constexpr (pt == wq) return queenMoves(square, occupancy);
+  else return m_kingMoves[square];
+}
+
 // GROUP B SKILL: simple user-defined algorithms
+template<bool isWhite>
 Bitboard MoveGenerator::getDangerSquares(Position& position) {
-  Bitboard dangerSquares = 0;
-
-  bool isWhite = position.isWhiteToMove();
-  Bitboard occ = position.getWhiteOccupancy() | position.getBlackOccupancy();
+  Bitboard occ = position.getOccupancy();
   occ &= ~position.getPieces(isWhite ? wk : bk); // ignore our king
 
   // enemy pawn attacks
-  dangerSquares |= pawnAttacks(position.getPieces(isWhite ? bp : wp), !isWhite);
-
-  // for each other piece type
-  for(int t=wn; t<=wk; ++t) {
-    PieceType type = (PieceType) (t + isWhite*6); // enemy piece type
-    Bitboard i = position.getPieces(type);
-    while(i.getBits()) {
-      int index = i.popLsb();
-      switch(t) {
-        case wn:
-          dangerSquares |= m_knightMoves[index];
-          break;
-        case wb:
-          dangerSquares |= bishopMoves(index, occ);
-          break;
-        case wr:
-          dangerSquares |= rookMoves(index, occ);
-          break;
-        case wq:
-          dangerSquares |= queenMoves(index, occ);
-          break;
-        case wk:
-          dangerSquares |= m_kingMoves[index];
-          break;
-      }
-    }
-  }
+  Bitboard dangerSquares = pawnAttacks<!isWhite>(position.getPieces(isWhite ? bp : wp));
+
+  // for each other enemy piece type
+  dangerSquares |= getAttacks<wn>(position.getPieces(isWhite ? bn : wn), occ);
+  dangerSquares |= getAttacks<wb>(position.getPieces(isWhite ? bb : wb), occ);
+  dangerSquares |= getAttacks<wr>(position.getPieces(isWhite ? br : wr), occ);
+  dangerSquares |= getAttacks<wq>(position.getPieces(isWhite ? bq : wq), occ);
+  dangerSquares |= getAttacks<wk>(position.getPieces(isWhite ? bk : wk), occ);
 
   return dangerSquares;
 }
 
+// union of the squares attacked by each of (pieces), which are all of type (pt)
+template<PieceType pt>
+Bitboard MoveGenerator::getAttacks(Bitboard pieces, Bitboard occupancy) {
+  Bitboard attacks = 0;
+  while(pieces.getBits()) attacks |= pieceMoves<pt>(pieces.popLsb(), occupancy);
+  return attacks;
+}
+
+Bitboard MoveGenerator::getCheckingPieces(Position& position) {
+  return position.isWhiteToMove() ? getCheckingPieces<true>(position) : getCheckingPieces<false>(position);
+}
+
 // GROUP B SKILL: simple user-defined algorithms
+template<bool isWhite>
 Bitboard MoveGenerator::getCheckingPieces(Position& position) {
   Bitboard checkers = 0;
-  bool isWhite = position.isWhiteToMove();
-  Bitboard occ = position.getWhiteOccupancy() | position.getBlackOccupancy();
-  int kingSquare = position.getPieces(position.isWhiteToMove() ? wk : bk).getLsb();
+  Bitboard occ = position.getOccupancy();
+  int kingSquare = position.getPieces(isWhite ? wk : bk).getLsb();
 
   // for each piece type, pretend there is that piece type on the king square, then see if that piece cancapture an actual enemy piece of that type
   // ignore kings because king can't check the other king
-  checkers |= pawnAttacks(1ull<<kingSquare, isWhite) & position.getPieces(isWhite ? bp : wp);
+  checkers |= pawnAttacks<isWhite>(1ull<<kingSquare) & position.getPieces(isWhite ? bp : wp);
   checkers |= m_knightMoves[kingSquare] & position.getPieces(isWhite ? bn : wn);
-  checkers |= bishopMoves(kingSquare, occ) & position.getPieces(isWhite ? bb : wb);
-  checkers |= rookMoves(kingSquare, occ) & position.getPieces(isWhite ? br : wr);
-  checkers |= queenMoves(kingSquare, occ) & position.getPieces(isWhite ? bq : wq) ;
+  checkers |= bishopMoves(kingSquare, occ) & (position.getPieces(isWhite ? bb : wb) | position.getPieces(isWhite ? bq : wq));
+  checkers |= rookMoves(kingSquare, occ) & (position.getPieces(isWhite ? br : wr) | position.getPieces(isWhite ? bq : wq));
 
   return checkers;
 }
 
 // GROUP A SKILL: complex user-defined algorithms
-std::vector<Move> MoveGenerator::genMoves(Position& position, bool onlyCaptures) {
+// note: castling, en passant and promotions are rare, so they are checked against the full list of legal moves instead
+bool MoveGenerator::isLegal(Position& position, Move move) {
+  if(move.getType() != NORMAL) {
+    MoveList legalMoves;
+    genMoves(position, legalMoves, ALL);
+    for(Move m : legalMoves) {
+      if(m == move) return true;
+    }
+    return false;
+  }
+  return position.isWhiteToMove() ? isLegal<true>(position, move) : isLegal<false>(position, move);
+}
 
-  std::vector<Move> moveList;
-  bool isWhite = position.isWhiteToMove();
+template<bool isWhite>
+bool MoveGenerator::isLegal(Position& position, Move move) {
+  int start = move.getStart();
+  int end = move.getEnd();
   Bitboard own = isWhite ? position.getWhiteOccupancy() : position.getBlackOccupancy();
   Bitboard enemy = isWhite ? position.getBlackOccupancy() : position.getWhiteOccupancy();
-  Bitboard occ = own|enemy;
-  int kingSquare = position.getPieces(position.isWhiteToMove() ? wk : bk).getLsb();
+  Bitboard occ = position.getOccupancy();
+  Bitboard endBoard = 1ull<<end;
+
+  // must move one of our pieces, and not onto another one of ours or the enemy king
+  if((own & (1ull<<start)) == 0 || (own & endBoard) != 0) return false;
+  if(position.whichPiece(end) == (isWhite ? bk : wk)) return false;
+
+  // the piece must be able to reach the end square
+  PieceType piece = position.whichPiece(start);
+  Bitboard moves;
+  switch(piece) {
+    case wp: case bp:
+      if((endBoard & (firstRank|eigthRank)) != 0) return false; // would have to be a promotion
+      moves = pawnPushes<isWhite>(1ull<<start, occ) | (pawnAttacks<isWhite>(1ull<<start) & enemy);
+      break;
+    case wn: case bn: moves = m_knightMoves[start]; break;
+    case wb: case bb: moves = bishopMoves(start, occ); break;
+    case wr: case br: moves = rookMoves(start, occ); break;
+    case wq: case bq: moves = queenMoves(start, occ); break;
+    default: moves = m_kingMoves[start]; break;
+  }
+  if((moves & endBoard) == 0) return false;
+
+  // and mustn't leave our king attacked, by any enemy piece other than one it captures
+  Bitboard occAfter = (occ & ~(1ull<<start)) | endBoard;
+  int kingSquare = (piece == wk || piece == bk) ? end : position.getPieces(isWhite ? wk : bk).getLsb();
+  Bitboard attackers = pawnAttacks<isWhite>(1ull<<kingSquare) & position.getPieces(isWhite ? bp : wp);
+  attackers |= m_knightMoves[kingSquare] & position.getPieces(isWhite ? bn : wn);
+  attackers |= m_kingMoves[kingSquare] & position.getPieces(isWhite ? bk : wk);
+  attackers |= bishopMoves(kingSquare, occAfter) & (position.getPieces(isWhite ? bb : wb) | position.getPieces(isWhite ? bq : wq));
+  attackers |= rookMoves(kingSquare, occAfter) & (position.getPieces(isWhite ? br : wr) | position.getPieces(isWhite ? bq : wq));
+  return (attackers & ~endBoard) == 0;
+}
 
-  Bitboard checks = getCheckingPieces(position);
-  Bitboard pushMask = 0xffffffffffffffff; // valid squares to move that block a check - if not in check, then this is all squares
-  Bitboard captureMask = 0xffffffffffffffff; // valid squares to move that capture a checking piece - if not in check, then this is all squares
-  // if in single check
-  if(checks.popcnt() == 1) {
-    captureMask = checks;
-    pushMask = m_rookPushMasks[kingSquare][checks.getLsb()] | m_bishopPushMasks[kingSquare][checks.getLsb()];
+Bitboard MoveGenerator::getAttackersTo(Position& position, int square, Bitboard occupancy) {
+  Bitboard target = 1ull<<square;
+  Bitboard attackers = pawnAttacks<false>(target) & position.getPieces(wp);
+  attackers |= pawnAttacks<true>(target) & position.getPieces(bp);
+  attackers |= m_knightMoves[square] & (position.getPieces(wn) | position.getPieces(bn));
+  attackers |= m_kingMoves[square] & (position.getPieces(wk) | position.getPieces(bk));
+  attackers |= bishopMoves(square, occupancy) & (position.getPieces(wb) | position.getPieces(bb) | position.getPieces(wq) | position.getPieces(bq));
+  attackers |= rookMoves(square, occupancy) & (position.getPieces(wr) | position.getPieces(br) | position.getPieces(wq) | position.getPieces(bq));
+  return attackers & occupancy;
+}
+
+// GROUP A SKILL: complex user-defined algorithms
+// swap list algorithm: gain[d] is the material won by the side making capture d, if it is recaptured
+double MoveGenerator::see(Position& position, Move move, const double* pieceValues) {
+  if(move.getType() == CASTLING) return 0;
+  int start = move.getStart();
+  int end = move.getEnd();
+  // the king is never actually captured, but must be worth more than anything for the pruning below
+  const double kingValue = 1000;
+  auto value = [&](PieceType pt) { return (pt == wk || pt == bk) ? kingValue : pieceValues[pt]; };
+
+  Bitboard occ = position.getOccupancy() & ~(1ull<<start);
+  PieceType piece = position.whichPiece(start);
+  double gain[32];
+  gain[0] = 0;
+  if(move.isEnPassant()) {
+    gain[0] = pieceValues[wp];
+    occ &= ~(1ull<<(end + (end > start ? -8 : 8)));
+  }
+  else if(position.whichPiece(end) != empty) gain[0] = value(position.whichPiece(end));
+  // a promoting pawn becomes the piece that can be recaptured
+  if(move.getPromotion()) {
+    piece = (PieceType) move.getPromotion();
+    gain[0] += pieceValues[piece] - pieceValues[wp];
   }
 
-  // king moves (only one king)
-  Bitboard moves = m_kingMoves[kingSquare];
-  Bitboard dangerSquares = getDangerSquares(position);
-  moves &= ~own;
-  moves &= ~dangerSquares;
-  if(onlyCaptures) moves &= enemy;
+  Bitboard bishops = position.getPieces(wb) | position.getPieces(bb) | position.getPieces(wq) | position.getPieces(bq);
+  Bitboard rooks = position.getPieces(wr) | position.getPieces(br) | position.getPieces(wq) | position.getPieces(bq);
+  Bitboard attackers = getAttackersTo(position, end, occ);
+  bool white = !position.isWhiteToMove(); // side to recapture
+  int d = 0;
+  while(true) {
+    d++;
+    gain[d] = value(piece) - gain[d-1];
+    // neither side would choose to carry on from here
+    if(std::max(-gain[d-1], gain[d]) < 0) break;
+
+    // least valuable attacker of the side to recapture
+    Bitboard own = attackers & (white ? position.getWhiteOccupancy() : position.getBlackOccupancy());
+    if(own.getBits() == 0) break;
+    int from = -1;
+    for(int pt = white ? wp : bp; pt <= (white ? wk : bk); ++pt) {
+      Bitboard candidates = own & position.getPieces((PieceType) pt);
+      if(candidates.getBits()) {
+        from = candidates.getLsb();
+        piece = (PieceType) pt;
+        break;
+      }
+    }
+    // the king can't recapture onto a defended square
+    if((piece == wk || piece == bk) && (attackers & ~own).getBits()) break;
+
+    // removing the attacker may reveal a slider behind it
+    occ &= ~(1ull<<from);
+    attackers |= (bishopMoves(end, occ) & bishops) | (rookMoves(end, occ) & rooks);
+    attackers &= occ;
+    white = !white;
+  }
+  while(--d) gain[d-1] = -std::max(-gain[d-1], gain[d]);
+  return gain[0];
+}
+
+void MoveGenerator::genMoves(Position& position, MoveList& moveList, GenType type) {
+  moveList.clear();
+  bool isWhite = position.isWhiteToMove();
+  Bitboard checks = isWhite ? getCheckingPieces<true>(position) : getCheckingPieces<false>(position);
+  // when in check, the only legal moves are evasions, which don't need castling or pinned piece moves
+  if(type == ALL || type == EVASIONS) type = checks.getBits() ? EVASIONS : ALL;
+  switch(type) {
+    case CAPTURES: isWhite ? genMoves<true, CAPTURES>(position, moveList, checks) : genMoves<false, CAPTURES>(position, moveList, checks); break;
+    case QUIETS: isWhite ? genMoves<true, QUIETS>(position, moveList, checks) : genMoves<false, QUIETS>(position, moveList, checks); break;
+    case EVASIONS: isWhite ? genMoves<true, EVASIONS>(position, moveList, checks) : genMoves<false, EVASIONS>(position, moveList, checks); break;
+    case ALL: isWhite ? genMoves<true, ALL>(position, moveList, checks) : genMoves<false, ALL>(position, moveList, checks); break;
+  }
+}
+
+// adds a move for each square in (moves), starting from (start)
+// note: (moves) shouldn't contain pawn promotions
+void MoveGenerator::addMoves(MoveList& moveList, int start, Bitboard moves) {
+  while(moves.getBits()) moveList.push_back(Move(start, moves.popLsb()));
+}
+
+// adds the four possible promotions for each square in (moves), starting from (start)
+template<bool isWhite>
+void MoveGenerator::addPromotions(MoveList& moveList, int start, Bitboard moves) {
   while(moves.getBits()) {
     int end = moves.popLsb();
-    Move m = Move(kingSquare, end, isWhite ? wk : bk, false, false, false);
-    moveList.push_back(m);
+    moveList.push_back(Move(start, end, PROMOTION, isWhite ? wn : bn));
+    moveList.push_back(Move(start, end, PROMOTION, isWhite ? wb : bb));
+    moveList.push_back(Move(start, end, PROMOTION, isWhite ? wr : br));
+    moveList.push_back(Move(start, end, PROMOTION, isWhite ? wq : bq));
   }
+}
+
+// GROUP A SKILL: complex user-defined algorithms
+// (checks) is the occupancy of the pieces giving check, and must be empty if (type) is ALL and non-empty if (type) is EVASIONS
+template<bool isWhite, GenType type>
+void MoveGenerator::genMoves(Position& position, MoveList& moveList, Bitboard checks) {
+
+  constexpr PieceType pawn = isWhite ? wp : bp;
+  Bitboard own = isWhite ? position.getWhiteOccupancy() : position.getBlackOccupancy();
+  Bitboard enemy = isWhite ? position.getBlackOccupancy() : position.getWhiteOccupancy();
+  Bitboard occ = position.getOccupancy();
+  int kingSquare = position.getPieces(isWhite ? wk : bk).getLsb();
+
+  // squares that pieces may move to for this type of generation
+  Bitboard targets = (type == CAPTURES) ? enemy : (type == QUIETS) ? ~occ : ~own;
+
+  // valid squares to move that block or capture a checking piece - if not in check, then this is all squares
+  Bitboard checkMask = 0xffffffffffffffff;
+  // if in single check
+  if(type != ALL && checks.popcnt() == 1) {
+    int checker = checks.getLsb();
+    checkMask = checks | m_rookPushMasks[kingSquare][checker] | m_bishopPushMasks[kingSquare][checker];
+  }
+
+  // king moves (only one king)
+  Bitboard dangerSquares = getDangerSquares<isWhite>(position);
+  addMoves(moveList, kingSquare, m_kingMoves[kingSquare] & targets & ~dangerSquares);
+
   // castling
-  if(!onlyCaptures && checks.getBits()==0) {
-    if(isWhite) {
-      if(
-        position.canWhiteCastleKingside()
-        && (occ&96) == 0 // f1,g1 are unoccupied
-        && (dangerSquares&96) == 0 // f1,g1 are unattacked
-      ) moveList.push_back(Move(4, 6, wk, 1, false, false));
-      if(
-        position.canWhiteCastleQueenside()
-        && (occ&14) == 0 // b1,c1,d1 are unoccupied
-        && (dangerSquares&12) == 0 // c1,d1 are unattacked
-      ) moveList.push_back(Move(4, 2, wk, 2, false, false));
-    } else {
-      if(
-        position.canBlackCastleKingside()
-        && (occ&(96ull<<56)) == 0 // f8,g8 are unoccupied
-        && (dangerSquares&(96ull<<56)) == 0 // f8,g8 are unattacked
-      ) moveList.push_back(Move(60, 62, bk, 3, false, false));
-      if(
-        position.canBlackCastleQueenside()
-        && (occ&(14ull<<56)) == 0 // b8,c8,d8 are unoccupied
-        && (dangerSquares&(12ull<<56)) == 0 // c8,d8 are unattacked
-      ) moveList.push_back(Move(60, 58, bk, 4, false, false));
+  if constexpr (type == QUIETS || type == ALL) {
+    if(type == ALL || checks.getBits()==0) {
+      if constexpr (isWhite) {
+        if(
+          position.canWhiteCastleKingside()
+          && (occ&96) == 0 // f1,g1 are unoccupied
+          && (dangerSquares&96) == 0 // f1,g1 are unattacked
+        ) moveList.push_back(Move(4, 6, CASTLING));
+        if(
+          position.canWhiteCastleQueenside()
+          && (occ&14) == 0 // b1,c1,d1 are unoccupied
+          && (dangerSquares&12) == 0 // c1,d1 are unattacked
+        ) moveList.push_back(Move(4, 2, CASTLING));
+      } else {
+        if(
+          position.canBlackCastleKingside()
+          && (occ&(96ull<<56)) == 0 // f8,g8 are unoccupied
+          && (dangerSquares&(96ull<<56)) == 0 // f8,g8 are unattacked
+        ) moveList.push_back(Move(60, 62, CASTLING));
+        if(
+          position.canBlackCastleQueenside()
+          && (occ&(14ull<<56)) == 0 // b8,c8,d8 are unoccupied
+          && (dangerSquares&(12ull<<56)) == 0 // c8,d8 are unattacked
+        ) moveList.push_back(Move(60, 58, CASTLING));
+      }
     }
   }
 
   // if in double check, then can only move king
-  if(checks.popcnt() > 1) return moveList;
+  if(type != ALL && checks.popcnt() > 1) return;
 
   // PINNED PIECE MOVES
   Bitboard pinnedPieces = 0;
   // for each of the opponents sliding pieces (bishop, rook, queen), find pieces that are in between our
   // king and the sliding piece (if applicable/if any) - if only one found and it is ours then that piece is pinned,
   // and the pinned piece's legal moves are a subset of the push mask (along with capturing the pinning piece)
-  for(int t=wb; t<=wq; ++t) {
-    Bitboard enemyPieces = position.getPieces((PieceType)(t + isWhite*6));
-    while(enemyPieces.getBits()) {
-      int slidingPiece = enemyPieces.popLsb();
-      Bitboard squaresBetween = 0;
-      if(t!=wb) squaresBetween |= m_rookPushMasks[kingSquare][slidingPiece];
-      if(t!=wr) squaresBetween |= m_bishopPushMasks[kingSquare][slidingPiece];
-      Bitboard piecesBetween = squaresBetween & (own|enemy);
-      if(piecesBetween.popcnt() == 1 && (piecesBetween&enemy) == 0) { // if only one piece in between, and that piece isn't an enemy piece
-        pinnedPieces |= piecesBetween;
-        // different piece types have different move options e.g. knights can never move when pinned
-        PieceType type = position.whichPiece(piecesBetween.getLsb());
-        if(type==wp || type==bp) {
-          // if the pinned piece is a pawn
-          int index = piecesBetween.getLsb();
-          Bitboard pushes = pawnPushes(piecesBetween, isWhite, occ) & squaresBetween;
-          Bitboard attacks = pawnAttacks(piecesBetween, isWhite) & (squaresBetween|(1ull<<slidingPiece));
-          Bitboard captures = attacks & enemy;
-          Bitboard moves = (captures & captureMask) | (pushes & pushMask);
-          if(onlyCaptures) moves &= enemy;
-
-          Bitboard nonPromotions = isWhite ? (moves & ~eigthRank) : (moves & ~firstRank);
-          while(nonPromotions.getBits()) moveList.push_back(Move(index, nonPromotions.popLsb(), type, false, false, false));
-          Bitboard promotions = isWhite ? (moves & eigthRank) : (moves & firstRank);
-          while(promotions.getBits()) {
-            int end = promotions.popLsb(); 
-            moveList.push_back(Move(index, end, type, false, isWhite ? wn : bn, false));
-            moveList.push_back(Move(index, end, type, false, isWhite ? wb : bb, false));
-            moveList.push_back(Move(index, end, type, false, isWhite ? wr : br, false));
-            moveList.push_back(Move(index, end, type, false, isWhite ? wq : bq, false));
-          }
-
-          // en passant moves
-          Bitboard enPassant = position.getEnPassant();
-          if(enPassant.getBits()) {
-            Bitboard epPushes = attacks & enPassant & (thirdRank|sixthRank) & squaresBetween; // ep pushes (i.e. where the pawn ends up) must be on the third/sixth rank
-            Bitboard epCaptures = enPassantCaptures(1ull<<index) & enPassant & fourthFifthRank & squaresBetween; // ep captures (i.e. where the captured pawn is) must be on fourth/fifth rank
-            Bitboard epMoves = isWhite ? (epCaptures&captureMask)<<8 : (epCaptures&captureMask)>>8;
-            epMoves |= epPushes & pushMask;
-            while(epMoves.getBits()) moveList.push_back(Move(index, epMoves.popLsb(), type, false, false, true));
-          }
-        } else if(t!=wr && (type==wb || type==bb)) {// bishop can't move if pinned by rook
-          // if the pinned piece is a bishop
-          int index = piecesBetween.getLsb();
-          Bitboard moves = bishopMoves(piecesBetween.getLsb(), occ) & (squaresBetween|(1ull<<slidingPiece));
-          moves &= ~own;
-          if(onlyCaptures) moves &= enemy;
-          moves = (moves & captureMask) | (moves & pushMask);
-          while(moves.getBits()) moveList.push_back(Move(index, moves.popLsb(), type, false, false, false));
-        } else if(t!=wb && (type==wr || type==br)) {// rook can't move if pinned by bishop
-          // if the pinned piece is a rook
-          int index = piecesBetween.getLsb();
-          Bitboard moves = rookMoves(piecesBetween.getLsb(), occ) & (squaresBetween|(1ull<<slidingPiece));
-          moves &= ~own;
-          if(onlyCaptures) moves &= enemy;
-          moves = (moves & captureMask) | (moves & pushMask);
-          while(moves.getBits()) moveList.push_back(Move(index, moves.popLsb(), type, false, false, false));
-        } else if(type==wq || type==bq) {
-          // if the pinned piece is a queen
-          int index = piecesBetween.getLsb();
-          Bitboard moves = queenMoves(piecesBetween.getLsb(), occ) & (squaresBetween|(1ull<<slidingPiece));
-          moves &= ~own;
-          if(onlyCaptures) moves &= enemy;
-          moves = (moves & captureMask) | (moves & pushMask);
-          while(moves.getBits()) moveList.push_back(Move(index, moves.popLsb(), type, false, false, false));
-        }
+  // note: a pinned piece can never resolve a check, so when in check the pinned pieces are found but not moved
+  bool inCheck = type == EVASIONS || (type != ALL && checks.getBits());
+  Bitboard enemyBishops = position.getPieces(isWhite ? bb : wb) | position.getPieces(isWhite ? bq : wq);
+  Bitboard enemyRooks = position.getPieces(isWhite ? br : wr) | position.getPieces(isWhite ? bq : wq);
+  // only sliders lined up with our king can pin anything
+  Bitboard pinners = (enemyBishops & bishopMoves(kingSquare, 0)) | (enemyRooks & rookMoves(kingSquare, 0));
+  while(pinners.getBits()) {
+    int slidingPiece = pinners.popLsb();
+    bool isRookPin = (rookMoves(kingSquare, 0) & (1ull<<slidingPiece)) != 0; // same rank or file as our king
+    Bitboard squaresBetween = isRookPin ? m_rookPushMasks[kingSquare][slidingPiece] : m_bishopPushMasks[kingSquare][slidingPiece];
+    Bitboard piecesBetween = squaresBetween & occ;
+    if(piecesBetween.popcnt() != 1 || (piecesBetween&enemy) != 0) continue; // if only one piece in between, and that piece isn't an enemy piece
+    pinnedPieces |= piecesBetween;
+    if(inCheck) continue;
+
+    // different piece types have different move options e.g. knights can never move when pinned
+    int index = piecesBetween.getLsb();
+    PieceType pinnedType = position.whichPiece(index);
+    Bitboard pinLine = squaresBetween|(1ull<<slidingPiece);
+    if(pinnedType == pawn) {
+      // if the pinned piece is a pawn
+      Bitboard pushes = pawnPushes<isWhite>(piecesBetween, occ) & squaresBetween;
+      Bitboard attacks = pawnAttacks<isWhite>(piecesBetween) & pinLine;
+      Bitboard moves = 0;
+      if constexpr (type != QUIETS) moves |= attacks & enemy;
+      if constexpr (type != CAPTURES) moves |= pushes;
+
+      addMoves(moveList, index, isWhite ? (moves & ~eigthRank) : (moves & ~firstRank));
+      addPromotions<isWhite>(moveList, index, isWhite ? (moves & eigthRank) : (moves & firstRank));
+
+      // en passant moves
+      Bitboard enPassant = position.getEnPassant();
+      if(type != QUIETS && enPassant.getBits()) {
+        Bitboard epMoves = attacks & enPassant & (thirdRank|sixthRank); // ep pushes (i.e. where the pawn ends up) must be on the third/sixth rank
+        while(epMoves.getBits()) moveList.push_back(Move(index, epMoves.popLsb(), EN_PASSANT));
       }
+    } else if(!isRookPin && (pinnedType==wb || pinnedType==bb || pinnedType==wq || pinnedType==bq)) { // bishop can't move if pinned by rook
+      addMoves(moveList, index, bishopMoves(index, occ) & pinLine & targets);
+    } else if(isRookPin && (pinnedType==wr || pinnedType==br || pinnedType==wq || pinnedType==bq)) { // rook can't move if pinned by bishop
+      addMoves(moveList, index, rookMoves(index, occ) & pinLine & targets);
     }
   }
 
   // normal pawn moves
-  PieceType type = isWhite ? wp : bp;
-  Bitboard i = position.getPieces(type) & ~pinnedPieces;
+  Bitboard i = position.getPieces(pawn) & ~pinnedPieces;
   Bitboard enPassant = position.getEnPassant();
   while(i.getBits()) {
 
     int index = i.popLsb();
-    Bitboard pushes = pawnPushes(1ull<<index, isWhite, occ);
-    Bitboard attacks = pawnAttacks(1ull<<index, isWhite);
-    Bitboard captures = attacks & enemy;
-    Bitboard moves = (captures & captureMask) | (pushes & pushMask);
-    if(onlyCaptures) moves &= enemy;
-    Bitboard nonPromotions = isWhite ? (moves & ~eigthRank) : (moves & ~firstRank);
-    while(nonPromotions.getBits()) moveList.push_back(Move(index, nonPromotions.popLsb(), type, false, false, false));
-    Bitboard promotions = isWhite ? (moves & eigthRank) : (moves & firstRank);
-    while(promotions.getBits()) {
-      int end = promotions.popLsb(); 
-      moveList.push_back(Move(index, end, type, false, isWhite ? wn : bn, false));
-      moveList.push_back(Move(index, end, type, false, isWhite ? wb : bb, false));
-      moveList.push_back(Move(index, end, type, false, isWhite ? wr : br, false));
-      moveList.push_back(Move(index, end, type, false, isWhite ? wq : bq, false));
-    }
+    Bitboard attacks = pawnAttacks<isWhite>(1ull<<index);
+    Bitboard moves = 0;
+    if constexpr (type != QUIETS) moves |= attacks & enemy;
+    if constexpr (type != CAPTURES) moves |= pawnPushes<isWhite>(1ull<<index, occ);
+    moves &= checkMask;
+    addMoves(moveList, index, isWhite ? (moves & ~eigthRank) : (moves & ~firstRank));
+    addPromotions<isWhite>(moveList, index, isWhite ? (moves & eigthRank) : (moves & firstRank));
 
     // en passant
-    if(enPassant.getBits()) {
+    if(type != QUIETS && enPassant.getBits()) {
       Bitboard epPushes = attacks & enPassant & (thirdRank|sixthRank); // ep pushes (i.e. where the pawn ends up) must be on the third/sixth rank
       Bitboard epCaptures = enPassantCaptures(1ull<<index) & enPassant & fourthFifthRank; // ep captures (i.e. where the captured pawn is) must be on fourth/fifth rank
-      Bitboard epMoves = isWhite ? (epCaptures&captureMask)<<8 : (epCaptures&captureMask)>>8;
-      epMoves |= epPushes & pushMask;
+      Bitboard epMoves = isWhite ? (epCaptures&checkMask)<<8 : (epCaptures&checkMask)>>8;
+      epMoves |= epPushes & checkMask;
       bool valid = true;
-      if(epMoves.getBits() && ( // en passant moves exist
-            (isWhite && (kingSquare>>3) == 4) // white to move and white king on 5th rank
-            || (!isWhite && (kingSquare>>3) == 3) // black to move and black king on 4th rank
-        )) {
+      if(epMoves.getBits() && (kingSquare>>3) == (isWhite ? 4 : 3)) { // en passant moves exist, and our king is on the same rank as the pawns
         // deal with en passant double reveal pin issue
-        Position pawnsRemoved = position;
-        pawnsRemoved.removePieces(type, 1ull<<index);
-        pawnsRemoved.removePieces(isWhite ? bp : wp, epCaptures);
-        if(getCheckingPieces(pawnsRemoved).getBits()) valid = false;
+        // note: removePieces toggles the pieces, so calling it again puts them back
+        position.removePieces(pawn, 1ull<<index);
+        position.removePieces(isWhite ? bp : wp, epCaptures);
+        if(getCheckingPieces<isWhite>(position).getBits()) valid = false;
+        position.removePieces(pawn, 1ull<<index);
+        position.removePieces(isWhite ? bp : wp, epCaptures);
       }
       if(valid) {
-        while(epMoves.getBits()) moveList.push_back(Move(index, epMoves.popLsb(), type, false, false, true));
+        while(epMoves.getBits()) moveList.push_back(Move(index, epMoves.popLsb(), EN_PASSANT));
       }
     }
   }
 
   // normal moves for each other piece type
-  for(int t=wn; t<wk; ++t) {
-    PieceType type = (PieceType) (t + (!isWhite)*6);
-    Bitboard i = position.getPieces(type) & ~pinnedPieces;
-    while(i.getBits()) {
-      Bitboard moves = 0;
-      int index = i.popLsb();
-      switch(t) {
-        case wn:
-          moves |= m_knightMoves[index];
-          break;
-        case wb:
-          moves |= bishopMoves(index, occ);
-          break;
-        case wr:
-          moves |= rookMoves(index, occ);
-          break;
-        case wq:
-          moves |= queenMoves(index, occ);
-          break;
-      }
-      moves &= ~own;
-      if(onlyCaptures) moves &= enemy;
-      moves = (moves & captureMask) | (moves & pushMask);
-      while(moves.getBits()) moveList.push_back(Move(index, moves.popLsb(), type, false, false, false));
-    }
-  }
+  genPieceMoves<isWhite, wn>(position, moveList, ~pinnedPieces, occ, targets & checkMask);
+  genPieceMoves<isWhite, wb>(position, moveList, ~pinnedPieces, occ, targets & checkMask);
+  genPieceMoves<isWhite, wr>(position, moveList, ~pinnedPieces, occ, targets & checkMask);
+  genPieceMoves<isWhite, wq>(position, moveList, ~pinnedPieces, occ, targets & checkMask);
 
-  return moveList;
+}
 
+// moves for every unpinned piece of type (pt), which is given as the white piece type
+template<bool isWhite, PieceType pt>
+void MoveGenerator::genPieceMoves(Position& position, MoveList& moveList, Bitboard unpinned, Bitboard occupancy, Bitboard targets) {
+  Bitboard i = position.getPieces((PieceType) (pt + (!isWhite)*6)) & unpinned;
+  while(i.getBits()) {
+    int index = i.popLsb();
+    addMoves(moveList, index, pieceMoves<pt>(index, occupancy) & targets);
+  }
 }
@@ -4,45 +4,93 @@
 #include "Position.h"
 #include "Move.h"
 #include "Util.h"
-#include <vector>
+#include <mutex>
+
+// which legal moves genMoves should produce
+// note: quiet moves are all moves that aren't captures, including castling and non-capturing promotions
+//       (en passant counts as a capture)
+// note: evasions are the legal moves when in check, and are generated in place of ALL whenever in check
+enum GenType {
+  CAPTURES, QUIETS, EVASIONS, ALL
+};
 
 // GROUP A SKILL: complex OOP
 class MoveGenerator {
 
   public:
     MoveGenerator();
-    // legal move generation function
-    std::vector<Move> genMoves(Position& position, bool onlyCaptures);
+    // legal move generation function, writes the moves into the caller-supplied list
+    void genMoves(Position& position, MoveList& moveList, GenType type);
     // returns occupancy bitboard of pieces giving check
     Bitboard getCheckingPieces(Position& position);
+    // whether (move) is legal in (position), for moves that didn't come from genMoves (e.g. from the hash table)
+    bool isLegal(Position& position, Move move);
+    // static exchange evaluation: the material (in units of (pieceValues)) won by (move) if both sides keep recapturing
+    // on its end square with their least valuable attacker, stopping whenever carrying on would lose more
+    // note: pins are ignored, and a king only recaptures if the square is no longer defended
+    double see(Position& position, Move move, const double* pieceValues);
+
+    // sliding piece lookups can use either magic numbers or, if the CPU has BMI2, the PEXT instruction
+    // PEXT is chosen by default when supported
+    bool isPextSupported();
+    bool isUsingPext();
+    // returns false (and keeps using magics) if PEXT is requested but not supported
+    bool setUsePext(bool usePext);
+    // checks that both backends agree on every sliding piece move board, returns true if so (or if PEXT is unsupported)
+    bool verifySliderBackends();
 
   private:
 
-    void initKnightMoveTable();
-    void initKingMoveTable();
-    void initRookBishopMoveTable(bool isRook);
-    void initPushMasks();
+    // the lookup tables are shared by every MoveGenerator, and built once by whichever is constructed first
+    static void initTables();
+    static std::once_flag m_tablesInitialised;
+
+    static void initKnightMoveTable();
+    static void initKingMoveTable();
+    static void initRookBishopMoveTable(bool isRook);
+    static void initRookBishopPextTable(bool isRook);
+    static void initRookBishopOffsets(bool isRook);
+    static void initPushMasks();
 
-    void findRookBishopMagics(bool isRook);
-    void initRookBishopBlockerMasks(bool isRook);
+    static void findRookBishopMagics(bool isRook);
+    static void initRookBishopBlockerMasks(bool isRook);
 
     // slow, used for generation at start only
-    Bitboard getBlockerBoard(Bitboard mask, int index);
-    Bitboard getRookBishopMoveBoard(bool isRook, Bitboard blockerBoard, int square);
+    static Bitboard getBlockerBoard(Bitboard mask, int index);
+    static Bitboard getRookBishopMoveBoard(bool isRook, Bitboard blockerBoard, int square);
+
+    // legal move generation, specialised at compile time for the side to move and the type of generation
+    template<bool isWhite, GenType type> void genMoves(Position& position, MoveList& moveList, Bitboard checks);
+    template<bool isWhite, PieceType pt> void genPieceMoves(Position& position, MoveList& moveList, Bitboard unpinned, Bitboard occupancy, Bitboard targets);
+    void addMoves(MoveList& moveList, int start, Bitboard moves);
+    template<bool isWhite> void addPromotions(MoveList& moveList, int start, Bitboard moves);
+    template<bool isWhite> Bitboard getCheckingPieces(Position& position);
+    // pieces of both colours attacking (square), given the (occupancy) left after earlier captures
+    Bitboard getAttackersTo(Position& position, int square, Bitboard occupancy);
+    template<bool isWhite> bool isLegal(Position& position, Move move);
 
     // pseudo-legal pawn move generation
-    Bitboard pawnPushes(Bitboard pawns, bool isWhite, Bitboard occupancy);
-    Bitboard pawnAttacks(Bitboard pawns, bool isWhite);
+    template<bool isWhite> Bitboard pawnPushes(Bitboard pawns, Bitboard occupancy);
+    template<bool isWhite> Bitboard pawnAttacks(Bitboard pawns);
     Bitboard enPassantCaptures(Bitboard pawns);
 
+    // pseudo-legal move generation for a knight, bishop, rook, queen or king, and for a set of them
+    template<PieceType pt> Bitboard pieceMoves(int square, Bitboard occupancy);
+    template<PieceType pt> Bitboard getAttacks(Bitboard pieces, Bitboard occupancy);
+
     // pseudo-legal move generation functions for sliding pieces
     Bitboard bishopMoves(int square, Bitboard occupancy);
     Bitboard rookMoves(int square, Bitboard occupancy);
     Bitboard queenMoves(int square, Bitboard occupancy);
+    // the same lookups for each backend
+    Bitboard bishopMagicMoves(int square, Bitboard occupancy);
+    Bitboard rookMagicMoves(int square, Bitboard occupancy);
+    Bitboard bishopPextMoves(int square, Bitboard occupancy);
+    Bitboard rookPextMoves(int square, Bitboard occupancy);
 
     // danger squares are squares attacked by an enemy piece,
     // ignoring your own king to avoid issues when in check from sliding piece
-    Bitboard getDangerSquares(Position& position);
+    template<bool isWhite> Bitboard getDangerSquares(Position& position);
 
     // useful for removing pieces on the A or H file when calculating pawn attacks
     Bitboard notAFile = ~0x0101010101010101; 
@@ -58,162 +106,179 @@ class MoveGenerator {
     Bitboard eigthRank = 0xff00000000000000;
 
     // STATIC LOOKUP TABLES: the key, k, is a board square
-    
+    // note: these are static so that there is one copy per process, which is only written to during initTables
+
     // GROUP B SKILL: multi-dimensional arrays
     // GROUP C SKILL: single-dimensional arrays
     // sliding piece moves between square k and another square: useful when calculating pins, and valid places to block sliding piece checks
-    Bitboard m_bishopPushMasks[64][64];
-    Bitboard m_rookPushMasks[64][64];
+    static Bitboard m_bishopPushMasks[64][64];
+    static Bitboard m_rookPushMasks[64][64];
 
     // possible knight moves from square k
-    Bitboard m_knightMoves[64];
+    static Bitboard m_knightMoves[64];
     // possible king moves from square k
-    Bitboard m_kingMoves[64];
+    static Bitboard m_kingMoves[64];
 
     // possible positions of a piece that would block a rook on square k ("blockers")
     // note: a piece on the board edge can't be a blocker because it could be captured, not obstructing movement
-    Bitboard m_rookMasks[64];
+    static Bitboard m_rookMasks[64];
     // rook moves on square k, "magic-indexed" (hashed) by an arrangement of blocker pieces
-    // note: at most 4096 possible blocker configurations (i.e. table indices) because a rook has at most 12 potential blockers
-    Bitboard m_rookMoves[64][4096];
+    // square k has 2^(number of potential blockers) indices, e.g. 2^12 in a corner but only 2^10 in the centre, so the
+    // indices of every square are packed into one table: square k uses (64 - shift k) bits, starting at offset k
+    static int m_rookShifts[64];
+    static int m_rookOffsets[64];
+    static const int ROOK_TABLE_SIZE = 102400;
+    static Bitboard m_rookMoves[ROOK_TABLE_SIZE];
 
     // same as above, for bishops
-    Bitboard m_bishopMasks[64];
-    Bitboard m_bishopMoves[64][512];
+    static Bitboard m_bishopMasks[64];
+    static int m_bishopShifts[64];
+    static int m_bishopOffsets[64];
+    static const int BISHOP_TABLE_SIZE = 5248;
+    static Bitboard m_bishopMoves[BISHOP_TABLE_SIZE];
+
+    // PEXT BACKEND
+    // the PEXT instruction gathers the blocker bits under the mask into a dense index, which needs exactly as many
+    // indices per square as the magics do, so the PEXT tables use the same offsets
+    // note: these are only filled in if the CPU supports BMI2, and otherwise never touch memory
+    static bool m_pextSupported;
+    bool m_usePext; // per generator, so that the backends can be compared in the same process
+    static Bitboard m_rookPextMoves[ROOK_TABLE_SIZE];
+    static Bitboard m_bishopPextMoves[BISHOP_TABLE_SIZE];
 
     // SLIDING PIECE MAGICS
-    // these were found by running the findRookBishopMagics function in Board.cpp
-    Bitboard m_rookMagics[64] = {
-      36029347062104064,
-      594475289326649352,
-      2341880671045427200,
-      36033229430456322,
-      72066390198452480,
-      153124590649081984,
-      1161929253650956352,
-      36029346778980608,
-      633318968131648,
-      70368947605760,
-      2286984319995906,
-      285873577918472,
-      141046726197376,
-      562984380334608,
-      140746615226497,
-      281476059496704,
-      72705208553472,
-      18983757561856,
-      2314850775412510720,
-      35192962171136,
-      352960412909569,
-      35734170107912,
-      282608856465472,
-      4503737070551312,
-      563091704152064,
-      581092031594504,
-      2251941682872328,
-      5501854683136,
-      1125904235888656,
-      11020902859776,
-      292470629875744,
-      283675073716352,
-      35322214219904,
-      2251937523171456,
-      4574037125636096,
-      35343302660096,
-      17600792758400,
-      87969553711368,
-      36591748050321536,
-      288265561599639684,
-      4504149392754688,
-      2331034444111872,
-      9570252354488320,
-      2251817035530248,
-      18032003580495872,
-      70385924080128,
-      282024867006466,
-      288230513625268744,
-      598168686297632,
-      17593268177168,
-      288239176540749954,
-      9079767089291296,
-      562988616516624,
-      36029363954712832,
-      627069420548,
-      4785075677896720,
-      140737758953537,
-      70368886788129,
-      281612416204817,
-      2199292223554,
-      17626546110465,
-      2233458753537,
-      8864829407364,
-      275423428866,
+    // these were found by running the findRookBishopMagics function in MoveGenerator.cpp
+    static inline Bitboard m_rookMagics[64] = {
+      36029072008052753,
+      2540030258560638976,
+      36037730559463424,
+      4935967732257525760,
+      36033195099553920,
+      72066398737662976,
+      144119758021722753,
+      972780268429517568,
+      4611826757832540298,
+      1730578526099210434,
+      36310409438826760,
+      2308235752674689408,
+      2306124505668388864,
+      288793403415594248,
+      441634255655690752,
+      140738721480960,
+      306247523444499840,
+      4503874511569104,
+      704237734760448,
+      216314070029176832,
+      2305984297598715904,
+      72198881349206529,
+      3179554531207876610,
+      2314861203595219973,
+      180144295406215168,
+      72234069953347848,
+      4692751087674853376,
+      1801527816175550472,
+      162701336927039744,
+      3387832828312948744,
+      144117404279083048,
+      144116571055358985,
+      144258399473762592,
+      18049618352803840,
+      4616331661221568512,
+      126383432790974506,
+      9151252466239488,
+      2305983763890315776,
+      2266128965435920,
+      577305728096666372,
+      36028934604734464,
+      22518135580016656,
+      40567585314504768,
+      589971585546354816,
+      290271136874624,
+      3941749252751496,
+      72357236743340040,
+      4645437843832836,
+      2954713341286679296,
+      140947996279040,
+      316951708598784,
+      5785650114274656768,
+      288373329860493440,
+      289074835508749056,
+      360429197304463488,
+      35463555711488,
+      10698321205149826,
+      81346406815903874,
+      4683770138187567365,
+      1153203598060947461,
+      9288683101620225,
+      5066601137704962,
+      11259592043071492,
+      694842971333599362,
     };
 
-    Bitboard m_bishopMagics[64] = {
-      9007345417850912,
-      9024868754395136,
-      4507998211022976,
-      36112360036892736,
-      422487880107008,
-      18049694684938240,
-      577586927356870656,
-      576482776962834432,
-      2305843318484897824,
-      558480098308,
-      9016005028225024,
-      290314023600192,
-      576601765776986112,
-      567207264320,
-      4535619813760,
-      140806476792960,
-      18014553130434592,
-      144396671643811968,
-      2251869611100168,
-      2306968978914025472,
-      4582764734054400,
-      70368878411776,
-      4522291870310400,
-      2207622645760,
-      70369029652736,
-      2251937420427520,
-      18700292064256,
-      18018796560253088,
-      153932173156352,
-      1125968644276352,
-      9070971715712,
-      71469329682448,
-      2256206450393152,
-      44547401318432,
-      17635136798784,
-      2305878227945588752,
-      2308097025230508048,
-      2306968978377017344,
-      144185591733422080,
-      565157568712832,
-      4611721340506873860,
-      1126041774981280,
-      2305847683216052224,
-      18014536087371808,
-      9380346986624,
-      2252144493199368,
-      1155175503645114880,
-      26388816461968,
-      17867332911105,
-      9012181483945984,
-      142004457488,
-      36028797325295616,
-      140772930256928,
-      4855444426260480,
-      148621055448056832,
-      149533850091520,
-      70385932472352,
-      8592056368,
-      144115222636922881,
-      70368760987912,
-      17302032,
-      138579829248,
-      2203989319688,
-      18015498591666240,
+    static inline Bitboard m_bishopMagics[64] = {
+      9016064344099953,
+      31529629807292416,
+      5192654803842369028,
+      2289459160678400,
+      582809890717825,
+      297819285915490338,
+      1171218649441108096,
+      108157893810979328,
+      1130336880952448,
+      21994662857985,
+      299221842403332,
+      4415234854912,
+      72062078520787072,
+      14637871857141888,
+      4611741007499935746,
+      6918655494551896642,
+      4785109668988930,
+      1176635917826801924,
+      282883759800336,
+      1334192111186157856,
+      5207287112115757381,
+      434107007629402112,
+      351865481998336,
+      1171499145740162081,
+      9152614231966208,
+      452616710399985682,
+      326532963250479616,
+      2306168464991076368,
+      72340168529461248,
+      4505867420959248,
+      91198452561645576,
+      4580565445575680,
+      577604279230137921,
+      285946056548608,
+      317449660794880,
+      587724153747933440,
+      290279659692544,
+      108376670718724369,
+      352947947046912,
+      9149663320015104,
+      145892120477760,
+      2451085231371847680,
+      2468289341315615232,
+      703825165953024,
+      20275565651037184,
+      4901059904255049792,
+      15789129849634880,
+      4900207769488982273,
+      1131981985837056,
+      141596524806144,
+      3458766714018726948,
+      2314990946502590632,
+      9483427266576,
+      36187264266739730,
+      18019934957338624,
+      14232083929038848,
+      1450722330749245440,
+      2252083416025601,
+      290484376131339284,
+      4611730548656966660,
+      3783041279447802370,
+      76561263996961222,
+      4618511821107658880,
+      146384670404706320,
     };
 };
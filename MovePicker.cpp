@@ -0,0 +1,145 @@
+#include "MovePicker.h"
+#include "Position.h"
+#include "Move.h"
+#include "MoveGenerator.h"
+
+// captures that lose material by static exchange evaluation are scored below this, so that they are left until last
+static const int BAD_CAPTURE = -1000000;
+
+MovePicker::MovePicker(Position& position, MoveGenerator& gen, MoveList& captures, MoveList& quiets, Move hashMove,
+  Move killer1, Move killer2, Move counterMove, int (*butterflyHistory)[64], int16_t* continuationHistory, const double* pieceValues)
+  : m_pos(position), m_gen(gen), m_captures(captures), m_quiets(&quiets), m_stage(STAGE_HASH_MOVE), m_capturesOnly(false),
+    m_hashMove(hashMove), m_refutationIndex(0), m_butterflyHistory(butterflyHistory),
+    m_continuationHistory(continuationHistory), m_pieceValues(pieceValues), m_current(0) {
+  m_refutations[0] = killer1;
+  m_refutations[1] = killer2;
+  m_refutations[2] = counterMove;
+}
+
+MovePicker::MovePicker(Position& position, MoveGenerator& gen, MoveList& captures, const double* pieceValues)
+  : m_pos(position), m_gen(gen), m_captures(captures), m_quiets(nullptr), m_stage(STAGE_GEN_CAPTURES), m_capturesOnly(true),
+    m_hashMove(Move(0, 0)), m_refutationIndex(0), m_butterflyHistory(nullptr),
+    m_continuationHistory(nullptr), m_pieceValues(pieceValues), m_current(0) {}
+
+// GROUP A SKILL: complex user-defined algorithms
+Move MovePicker::next() {
+  switch(m_stage) {
+
+    case STAGE_HASH_MOVE:
+      m_stage = STAGE_GEN_CAPTURES;
+      if(m_hashMove != Move(0, 0) && m_gen.isLegal(m_pos, m_hashMove)) return m_hashMove;
+      [[fallthrough]];
+
+    case STAGE_GEN_CAPTURES:
+      m_gen.genMoves(m_pos, m_captures, CAPTURES);
+      scoreCaptures();
+      m_current = 0;
+      m_stage = STAGE_GOOD_CAPTURES;
+      [[fallthrough]];
+
+    case STAGE_GOOD_CAPTURES:
+      while(m_current < m_captures.size()) {
+        pickBest(m_captures, m_captureScores);
+        if(m_captureScores[m_current] < BAD_CAPTURE/2) break; // only bad captures left
+        Move move = m_captures[m_current++];
+        if(move != m_hashMove) return move;
+      }
+      // the captures search never tries losing captures, they can't raise the stand pat score
+      m_stage = m_capturesOnly ? STAGE_DONE : STAGE_REFUTATIONS;
+      if(m_capturesOnly) return next();
+      [[fallthrough]];
+
+    case STAGE_REFUTATIONS:
+      while(m_refutationIndex < 3) {
+        Move move = m_refutations[m_refutationIndex++];
+        if(move == Move(0, 0) || move == m_hashMove || !m_pos.isQuiet(move)) continue;
+        // the killers and countermove could be the same move
+        bool duplicate = false;
+        for(int i=0; i<m_refutationIndex-1; ++i) duplicate |= (m_refutations[i] == move);
+        if(!duplicate && m_gen.isLegal(m_pos, move)) return move;
+      }
+      m_stage = STAGE_GEN_QUIETS;
+      [[fallthrough]];
+
+    case STAGE_GEN_QUIETS:
+      m_gen.genMoves(m_pos, *m_quiets, QUIETS);
+      scoreQuiets();
+      m_current = 0;
+      m_stage = STAGE_QUIETS;
+      [[fallthrough]];
+
+    case STAGE_QUIETS:
+      while(m_current < m_quiets->size()) {
+        pickBest(*m_quiets, m_quietScores);
+        Move move = (*m_quiets)[m_current++];
+        if(move != m_hashMove && !isRefutation(move)) return move;
+      }
+      // carry on from the first bad capture
+      m_current = 0;
+      while(m_current < m_captures.size() && m_captureScores[m_current] >= BAD_CAPTURE/2) m_current++;
+      m_stage = STAGE_BAD_CAPTURES;
+      [[fallthrough]];
+
+    case STAGE_BAD_CAPTURES:
+      while(m_current < m_captures.size()) {
+        pickBest(m_captures, m_captureScores);
+        Move move = m_captures[m_current++];
+        if(move != m_hashMove) return move;
+      }
+      m_stage = STAGE_DONE;
+      [[fallthrough]];
+
+    default:
+      return Move(0, 0);
+  }
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+// captures of valuable pieces with less valuable ones first, and captures that lose material last
+void MovePicker::scoreCaptures() {
+  for(int i=0; i<m_captures.size(); ++i) {
+    Move m = m_captures[i];
+    PieceType piece = m_pos.whichPiece(m.getStart());
+    PieceType captured = m.isEnPassant() ? wp : m_pos.whichPiece(m.getEnd());
+    int score = 10 * m_pieceValues[captured] - m_pieceValues[piece];
+    // pawn promotions are probably good
+    if(m.getPromotion()) score += m_pieceValues[m.getPromotion()];
+    // capturing a less valuable piece might lose the capturing piece for less, so check the exchange
+    else if(m_pieceValues[captured] < m_pieceValues[piece] && m_gen.see(m_pos, m, m_pieceValues) < 0) score += BAD_CAPTURE;
+    m_captureScores[i] = score;
+  }
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+// quiet moves that caused cutoffs in similar positions first
+void MovePicker::scoreQuiets() {
+  for(int i=0; i<m_quiets->size(); ++i) {
+    Move m = (*m_quiets)[i];
+    int start = m.getStart();
+    int end = m.getEnd();
+    int score = m_butterflyHistory[start][end];
+    if(m_continuationHistory) score += m_continuationHistory[m_pos.whichPiece(start)*64 + end];
+    // quiet promotions are probably good
+    if(m.getPromotion()) score += 1000000 * m_pieceValues[m.getPromotion()];
+    m_quietScores[i] = score;
+  }
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+// one step of selection sort, so that moves after a cutoff are never sorted
+void MovePicker::pickBest(MoveList& moves, int* scores) {
+  int best = m_current;
+  for(int i=m_current+1; i<moves.size(); ++i) {
+    if(scores[i] > scores[best]) best = i;
+  }
+  Move move = moves[best];
+  moves[best] = moves[m_current];
+  moves[m_current] = move;
+  int score = scores[best];
+  scores[best] = scores[m_current];
+  scores[m_current] = score;
+}
+
+bool MovePicker::isRefutation(Move move) {
+  return move == m_refutations[0] || move == m_refutations[1] || move == m_refutations[2];
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Position.h"
+#include "Move.h"
+#include "MoveGenerator.h"
+#include <cstdint>
+
+// the stages moves are picked in
+enum PickStage {
+  STAGE_HASH_MOVE, STAGE_GEN_CAPTURES, STAGE_GOOD_CAPTURES, STAGE_REFUTATIONS, STAGE_GEN_QUIETS, STAGE_QUIETS, STAGE_BAD_CAPTURES, STAGE_DONE
+};
+
+// GROUP A SKILL: complex OOP
+// hands out the legal moves of a position one at a time, most promising first
+// moves are only generated and scored when the previous stage runs out, so a node where an early move
+// causes a cutoff never generates (or sorts) its quiet moves
+class MovePicker {
+
+  public:
+    // for the main search
+    // (refutations) are the two killer moves and the countermove, tried after the good captures
+    // (butterflyHistory) is indexed by [start][end], (continuationHistory) by [piece*64 + end], and may be null
+    MovePicker(Position& position, MoveGenerator& gen, MoveList& captures, MoveList& quiets, Move hashMove,
+      Move killer1, Move killer2, Move counterMove, int (*butterflyHistory)[64], int16_t* continuationHistory, const double* pieceValues);
+    // for the quiescence search, which only searches captures that don't lose material
+    MovePicker(Position& position, MoveGenerator& gen, MoveList& captures, const double* pieceValues);
+
+    // returns the next move, or Move(0, 0) when there are none left
+    Move next();
+
+  private:
+    Position& m_pos;
+    MoveGenerator& m_gen;
+    MoveList& m_captures;
+    MoveList* m_quiets; // null in quiescence search
+    int m_stage;
+    bool m_capturesOnly;
+
+    Move m_hashMove;
+    // GROUP C SKILL: single-dimensional arrays
+    Move m_refutations[3];
+    int m_refutationIndex;
+
+    int (*m_butterflyHistory)[64];
+    int16_t* m_continuationHistory;
+    const double* m_pieceValues;
+
+    // GROUP C SKILL: single-dimensional arrays
+    // the score of each move in m_captures and m_quiets, and the index of the next one to pick
+    int m_captureScores[MAX_MOVES];
+    int m_quietScores[MAX_MOVES];
+    int m_current;
+
+    void scoreCaptures();
+    void scoreQuiets();
+    // swaps the highest scoring move in (moves) from index (m_current) onwards to index (m_current)
+    void pickBest(MoveList& moves, int* scores);
+    bool isRefutation(Move move);
+
+};
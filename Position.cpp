@@ -4,63 +4,38 @@
 #include "Util.h"
 #include <iostream>
 #include <string>
-#include <random>
 #include <vector>
 
-Position::Position() {
-
-  // init piece positions
-  m_board[0] = wr;
-  m_board[1] = wn;
-  m_board[2] = wb;
-  m_board[3] = wq;
-  m_board[4] = wk;
-  m_board[5] = wb;
-  m_board[6] = wn;
-  m_board[7] = wr;
-  for(int i=8; i<16; ++i) m_board[i] = wp;
-  for(int i=16; i<48; ++i) m_board[i] = empty;
-  for(int i=48; i<56; ++i) m_board[i] = bp;
-  m_board[56] = br;
-  m_board[57] = bn;
-  m_board[58] = bb;
-  m_board[59] = bq;
-  m_board[60] = bk;
-  m_board[61] = bb;
-  m_board[62] = bn;
-  m_board[63] = br;
-
-  m_enPassant = 0;
-
-  m_whiteToMove = true;
-  m_whiteCastleKingside = true;
-  m_whiteCastleQueenside = true;
-  m_blackCastleKingside = true;
-  m_blackCastleQueenside = true;
-
-  m_plysSince50 = 0;
-
-  // initialize piece bitboards
-  m_pieces[wp] = 255ull << 8;
-  m_pieces[wn] = 66ull;
-  m_pieces[wb] = 36ull;
-  m_pieces[wr] = 129ull;
-  m_pieces[wq] = 8ull;
-  m_pieces[wk] = 16ull;
-  m_pieces[bp] = 255ull << 48;
-  m_pieces[bn] = 66ull << 56;
-  m_pieces[bb] = 36ull << 56;
-  m_pieces[br] = 129ull << 56;
-  m_pieces[bq] = 8ull << 56;
-  m_pieces[bk] = 16ull << 56;
-
-}
+// castling rights kept when a move starts or ends on each square:
+// moving the king or a rook, or capturing a rook, removes the corresponding rights
+static const uint8_t CASTLING_MASK[64] = {
+  13, 15, 15, 15, 12, 15, 15, 14,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+   7, 15, 15, 15,  3, 15, 15, 11
+};
+
+Position::Position() : Position("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") {}
 
 // GROUP A SKILL: complex user-defined algorithms
 Position::Position(std::string FEN) {
 
+  Zobrist::init();
+
   for(int i=0; i<64; ++i) m_board[i] = empty;
   for(int i=0; i<12; ++i) m_pieces[i] = 0;
+  m_whiteOccupancy = 0;
+  m_blackOccupancy = 0;
+  m_occupancy = 0;
+  m_key = 0;
+  m_pawnKey = 0;
+  m_materialKey = 0;
+  m_enPassantSquare = 0;
+  m_plysSince50 = 0;
 
   int stringIndex = 0;
   int fenBoardIndex = 0;
@@ -84,8 +59,7 @@ Position::Position(std::string FEN) {
     int actualIndex = (fenBoardIndex&7) + (7-(fenBoardIndex>>3))*8; // fen index 0 is actual index 56, fen 1 is actual 57, etc
     std::string s("PNBRQKpnbrqk");
     int pieceType = s.find(c);
-    m_board[actualIndex] = (PieceType) pieceType;
-    m_pieces[pieceType] |= 1ull<<actualIndex;
+    putPiece((PieceType) pieceType, actualIndex);
     stringIndex++;
     c = FEN[stringIndex];
     fenBoardIndex++;
@@ -95,27 +69,25 @@ Position::Position(std::string FEN) {
   stringIndex++;
   c = FEN[stringIndex];
   m_whiteToMove = c == 'w';
+  if(!m_whiteToMove) m_key ^= Zobrist::blackToMove;
 
   // castling rights
   stringIndex+=2;
   c = FEN[stringIndex];
-  m_whiteCastleKingside = false;
-  m_whiteCastleQueenside = false;
-  m_blackCastleKingside = false;
-  m_blackCastleQueenside = false;
+  m_castlingRights = 0;
   while(c != ' ') {
     switch(c) {
       case 'K':
-        m_whiteCastleKingside = true;
+        m_castlingRights |= WHITE_KINGSIDE;
         break;
       case 'Q':
-        m_whiteCastleQueenside = true;
+        m_castlingRights |= WHITE_QUEENSIDE;
         break;
       case 'k':
-        m_blackCastleKingside = true;
+        m_castlingRights |= BLACK_KINGSIDE;
         break;
       case 'q':
-        m_blackCastleQueenside = true;
+        m_castlingRights |= BLACK_QUEENSIDE;
         break;
       default: // c might be -
         break;
@@ -129,10 +101,14 @@ Position::Position(std::string FEN) {
   c = FEN[stringIndex];
   if(c!='-') {
     int index = (c-'a') + (FEN[stringIndex+1]-'1')*8;
-    m_enPassant = 1ull<<index | (m_whiteToMove ? (1ull<<index)<<8 : (1ull<<index)>>8);
+    m_enPassantSquare = index;
     stringIndex++;
   }
 
+  // hash the castling rights and en passant square (pieces and side to move are hashed above)
+  m_key ^= Zobrist::castling[m_castlingRights];
+  if(m_enPassantSquare) m_key ^= Zobrist::enPassant[m_enPassantSquare&7];
+
   // if halfmove clock not provided, return
   stringIndex += 2;
   if(stringIndex >= FEN.length()) return;
@@ -149,178 +125,144 @@ Position::Position(std::string FEN) {
 
 }
 
-Bitboard Position::getWhiteOccupancy() {
-  return m_pieces[wp] | m_pieces[wn] | m_pieces[wb] | m_pieces[wr] | m_pieces[wq] | m_pieces[wk];
-}
+// GROUP A SKILL - complex user-defined algorithms
+// returns a 4-bit flag describing which castling rights were removed
+int Position::makeMove(Move move, StateInfo& state) {
+
+  // decode the move
+  int start = move.getStart();
+  int end = move.getEnd();
+  int promotion = move.getPromotion();
+  PieceType piece = m_board[start];
+
+  // remember what can't be undone from the move alone
+  PieceType pieceToDie = m_board[end];
+  state.captured = pieceToDie;
+  state.castlingRights = m_castlingRights;
+  state.enPassantSquare = m_enPassantSquare;
+  state.plysSince50 = m_plysSince50;
+  state.key = m_key;
+  state.pawnKey = m_pawnKey;
+  state.materialKey = m_materialKey;
 
-Bitboard Position::getBlackOccupancy() {
-  return m_pieces[bp] | m_pieces[bn] | m_pieces[bb] | m_pieces[br] | m_pieces[bq] | m_pieces[bk];
-}
+  // remove target piece if it exists
+  if(pieceToDie != empty) removePiece(pieceToDie, end);
 
-Bitboard Position::getPieces(PieceType pt) {
-  return m_pieces[pt];
-}
+  // move the piece, if a pawn promotion then it becomes the promoted piece
+  if(promotion) {
+    removePiece(piece, start);
+    putPiece((PieceType) promotion, end);
+  }
+  else movePiece(piece, start, end);
 
-Bitboard Position::getEnPassant() {
-  return m_enPassant;
-}
+  if(m_enPassantSquare) m_key ^= Zobrist::enPassant[m_enPassantSquare&7];
+  m_enPassantSquare = 0;
 
-void Position::removePieces(PieceType pt, Bitboard bb) {
-  m_pieces[pt] ^= bb;
-}
+  // if current move is double pawn push, then update en passant availability
+  if((piece==wp || piece==bp) && (end-start==16 || start-end==16)) {
+    m_enPassantSquare = (start+end)/2;
+    m_key ^= Zobrist::enPassant[start&7];
+  }
+  // if current move is en passant, then remove the piece to be captured
+  else if(move.isEnPassant()) {
+    if(m_whiteToMove) removePiece(bp, end-8);
+    else removePiece(wp, end+8);
+  }
+  // if current move is castling, then move the rook
+  else if(move.getType() == CASTLING) {
+    switch(move.getCastle()) {
+      case 1: movePiece(wr, 7, 5); break;
+      case 2: movePiece(wr, 0, 3); break;
+      case 3: movePiece(br, 63, 61); break;
+      default: movePiece(br, 56, 59); break;
+    }
+  }
 
-PieceType Position::whichPiece(int square) {
-  return m_board[square];
-}
+  // moving a king or rook, or capturing a rook, removes castling rights
+  int oldRights = m_castlingRights;
+  m_castlingRights &= CASTLING_MASK[start] & CASTLING_MASK[end];
+  m_key ^= Zobrist::castling[oldRights] ^ Zobrist::castling[m_castlingRights];
 
-bool Position::isWhiteToMove() {
-  return m_whiteToMove;
-}
+  // update 50 move rule
+  if(pieceToDie!=empty || piece==wp || piece==bp) m_plysSince50 = 0;
+  else m_plysSince50++;
 
-bool Position::canWhiteCastleKingside() {
-  return m_whiteCastleKingside;
-}
+  // flip player to move
+  m_whiteToMove = !m_whiteToMove;
+  m_key ^= Zobrist::blackToMove;
+
+  return oldRights & ~m_castlingRights;
 
-bool Position::canWhiteCastleQueenside() {
-  return m_whiteCastleQueenside;
-}
-bool Position::canBlackCastleKingside() {
-  return m_blackCastleKingside;
 }
 
-bool Position::canBlackCastleQueenside() {
-  return m_blackCastleQueenside;
+void Position::makeNullMove(StateInfo& state) {
+  state.captured = empty;
+  state.castlingRights = m_castlingRights;
+  state.enPassantSquare = m_enPassantSquare;
+  state.plysSince50 = m_plysSince50;
+  state.key = m_key;
+  state.pawnKey = m_pawnKey;
+  state.materialKey = m_materialKey;
+
+  if(m_enPassantSquare) m_key ^= Zobrist::enPassant[m_enPassantSquare&7];
+  m_enPassantSquare = 0;
+  m_plysSince50 = 0;
+  m_whiteToMove = !m_whiteToMove;
+  m_key ^= Zobrist::blackToMove;
 }
 
-int Position::getPlysSince50() {
-  return m_plysSince50;
+void Position::unmakeNullMove(StateInfo& state) {
+  m_whiteToMove = !m_whiteToMove;
+  m_enPassantSquare = state.enPassantSquare;
+  m_plysSince50 = state.plysSince50;
+  m_key = state.key;
 }
 
 // GROUP A SKILL - complex user-defined algorithms
-// returns a 4-bit flag describing which castling rights were removed
-int Position::makeMove(Move move) {
+void Position::unmakeMove(Move move, StateInfo& state) {
 
-  int flag = 0;
+  // flip player to move back
+  m_whiteToMove = !m_whiteToMove;
 
-  // remove target piece if it exists
-  PieceType pieceToDie = m_board[move.end];
-  if(pieceToDie != empty) {
-    Bitboard capturedPiece = 1ull<<move.end;
-    m_pieces[pieceToDie] &= ~capturedPiece;
+  // decode the move
+  int start = move.getStart();
+  int end = move.getEnd();
+  PieceType pieceOnEnd = m_board[end];
+  // if a pawn promotion, then the piece that moved was a pawn
+  PieceType piece = move.getPromotion() ? (m_whiteToMove ? wp : bp) : pieceOnEnd;
+
+  // move the piece back
+  if(piece != pieceOnEnd) {
+    removePiece(pieceOnEnd, end);
+    putPiece(piece, start);
   }
+  else movePiece(piece, end, start);
 
-  // move the piece
-  m_pieces[move.piece] &= ~(1ull<<move.start);
-  // if a pawn promotion, then update the right bitboard
-  if(move.promotion) m_pieces[move.promotion] |= 1ull<<move.end;
-  else m_pieces[move.piece] |= 1ull<<move.end;
-
-  // update square info
-  m_board[move.end] = (PieceType) (move.promotion ? move.promotion : move.piece);
-  m_board[move.start] = empty;
-
-  m_enPassant = 0;
-
-  // if current move is double pawn push, then update en passant availability
-  if(move.piece==wp && move.end-move.start==16) {
-    m_enPassant = (1ull<<move.end) | (1ull<<(move.end-8));
-  } else if(move.piece==bp && move.end-move.start==-16) {
-    m_enPassant = (1ull<<move.end) | (1ull<<(move.end+8));
-  }
-  // if current move is en passant, then remove the piece to be captured
-  else if(move.enPassant) {
-    Bitboard capturedPawn = 1ull<<move.end;
-    if(m_whiteToMove) capturedPawn >>= 8;
-    else capturedPawn <<= 8;
-    m_pieces[m_whiteToMove ? bp : wp] &= ~capturedPawn;
-    m_board[capturedPawn.getLsb()] = empty;
-  }
-  // if current move is a rook on (a1,h1,a8,h8), then remove corresponding castling rights
-  else if(move.piece==wr && move.start == 7) {
-    m_whiteCastleKingside = false;
-    flag |= 1;
-  }
-  else if(move.piece==wr && move.start == 0) {
-    m_whiteCastleQueenside = false;
-    flag |= 2;
-  }
-  else if(move.piece==br && move.start == 63) {
-    m_blackCastleKingside = false;
-    flag |= 4;
-  }
-  else if(move.piece==br && move.start == 56) {
-    m_blackCastleQueenside = false;
-    flag |= 8;
-  }
-  // if current move is king, then remove corresponding castling rights
-  else if(move.piece==wk) {
-    m_whiteCastleKingside = false;
-    m_whiteCastleQueenside = false;
-    flag |= 3;
-  }
-  else if(move.piece==bk) {
-    m_blackCastleKingside = false;
-    m_blackCastleQueenside = false;
-    flag |= 12;
-  }
+  // put back the captured piece, if any
+  if(state.captured != empty) putPiece(state.captured, end);
 
-  // if current move lands on an enemy starting rook square, remove corresponding castling rights
-  if(move.end == 7 && move.piece>=6) {
-    m_whiteCastleKingside = false;
-    flag |= 1;
-  }
-  else if(move.end == 0 && move.piece>=6) {
-    m_whiteCastleQueenside = false;
-    flag |= 2;
-  }
-  else if(move.end == 63 && move.piece<6) {
-    m_blackCastleKingside = false;
-    flag |= 4;
-  }
-  else if(move.end == 56 && move.piece<6) {
-    m_blackCastleQueenside = false;
-    flag |= 8;
+  // if en passant, put back the captured pawn
+  if(move.isEnPassant()) {
+    if(m_whiteToMove) putPiece(bp, end-8);
+    else putPiece(wp, end+8);
   }
 
-  // if current move is castling, then move the rook
-  if(move.castle) {
-    // white kingside castle
-    if(move.start == 4 && move.end == 6) {
-      m_pieces[wr] &= ~(1ull<<7);
-      m_pieces[wr] |= (1ull<<5);
-      m_board[7] = empty;
-      m_board[5] = wr;
-    }
-    // white queenside castle
-    else if(move.start == 4 && move.end == 2) {
-      m_pieces[wr] &= ~(1ull);
-      m_pieces[wr] |= (1ull<<3);
-      m_board[0] = empty;
-      m_board[3] = wr;
-    }
-    // black kingside castle
-    else if(move.start == 60 && move.end == 62) {
-      m_pieces[br] &= ~(1ull<<63);
-      m_pieces[br] |= (1ull<<61);
-      m_board[63] = empty;
-      m_board[61] = br;
-    }
-    // black queenside castle
-    else if(move.start == 60 && move.end == 58) {
-      m_pieces[br] &= ~(1ull<<56);
-      m_pieces[br] |= (1ull<<59);
-      m_board[56] = empty;
-      m_board[59] = br;
+  // if castling, then move the rook back
+  else if(move.getType() == CASTLING) {
+    switch(move.getCastle()) {
+      case 1: movePiece(wr, 5, 7); break;
+      case 2: movePiece(wr, 3, 0); break;
+      case 3: movePiece(br, 61, 63); break;
+      default: movePiece(br, 59, 56); break;
     }
   }
 
-  // update 50 move rule
-  if(pieceToDie!=empty || move.piece==wp || move.piece==bp) m_plysSince50 = 0;
-  else m_plysSince50++;
-
-  // flip player to move
-  m_whiteToMove = !m_whiteToMove;
-
-  return flag;
+  // restore the state that can't be undone from the move alone
+  m_castlingRights = state.castlingRights;
+  m_enPassantSquare = state.enPassantSquare;
+  m_plysSince50 = state.plysSince50;
+  m_key = state.key;
+  m_pawnKey = state.pawnKey;
+  m_materialKey = state.materialKey;
 
 }
@@ -2,9 +2,28 @@
 
 #include "Move.h"
 #include "Bitboard.h"
+#include "Zobrist.h"
 #include <string>
 #include <cstdint>
-#include <vector>
+
+// castling rights, each one bit of a 4-bit mask
+enum CastlingRights {
+  WHITE_KINGSIDE = 1, WHITE_QUEENSIDE = 2, BLACK_KINGSIDE = 4, BLACK_QUEENSIDE = 8
+};
+
+// GROUP B SKILL: simple OOP model
+// everything needed to undo a move that can't be worked out from the move itself,
+// so that search can make and unmake moves on a single position instead of copying it
+struct StateInfo {
+  PieceType captured; // piece on the end square before the move (empty if none, including en passant)
+  uint8_t castlingRights;
+  uint8_t enPassantSquare;
+  int plysSince50;
+  // hashes before the move
+  uint64_t key;
+  uint64_t pawnKey;
+  uint64_t materialKey;
+};
 
 // GROUP A SKILL - complex OOP
 class Position {
@@ -18,42 +37,126 @@ class Position {
     // bits (0,1,2,3) are whether
     // (white kingside, white queenside, black kingside, black queenside)
     // castling rights were removed, respectively
-    int makeMove(Move move);
-
-    Bitboard getWhiteOccupancy();
-    Bitboard getBlackOccupancy();
-    Bitboard getPieces(PieceType pt);
-    PieceType whichPiece(int square);
-    bool isWhiteToMove();
-    bool canWhiteCastleKingside();
-    bool canWhiteCastleQueenside();
-    bool canBlackCastleKingside();
-    bool canBlackCastleQueenside();
-    int getPlysSince50();
-    Bitboard getEnPassant();
+    // (state) is filled with the information needed by unmakeMove
+    int makeMove(Move move, StateInfo& state);
+    // restores the position from before makeMove(move, state)
+    void unmakeMove(Move move, StateInfo& state);
+    // passes the turn to the other side, for null move pruning
+    // note: resets the 50 move counter, so that no repetition is found across the null move
+    void makeNullMove(StateInfo& state);
+    void unmakeNullMove(StateInfo& state);
+
+    Bitboard getWhiteOccupancy() const { return m_whiteOccupancy; }
+    Bitboard getBlackOccupancy() const { return m_blackOccupancy; }
+    Bitboard getOccupancy() const { return m_occupancy; }
+    Bitboard getPieces(PieceType pt) const { return m_pieces[pt]; }
+    PieceType whichPiece(int square) const { return m_board[square]; }
+    // a quiet move is one that isn't a capture or promotion
+    bool isQuiet(Move move) const { return m_board[move.getEnd()] == empty && move.getType() != PROMOTION && !move.isEnPassant(); }
+    bool isWhiteToMove() const { return m_whiteToMove; }
+    bool canWhiteCastleKingside() const { return m_castlingRights & WHITE_KINGSIDE; }
+    bool canWhiteCastleQueenside() const { return m_castlingRights & WHITE_QUEENSIDE; }
+    bool canBlackCastleKingside() const { return m_castlingRights & BLACK_KINGSIDE; }
+    bool canBlackCastleQueenside() const { return m_castlingRights & BLACK_QUEENSIDE; }
+    int getPlysSince50() const { return m_plysSince50; }
+    Bitboard getEnPassant() const;
+
+    // zobrist hash of the whole position, updated by makeMove/unmakeMove
+    uint64_t getKey() const { return m_key; }
+    // zobrist hash of just the pawns, for caching pawn structure evaluation
+    uint64_t getPawnKey() const { return m_pawnKey; }
+    // hash of how many of each piece there are (not where they are), for caching material evaluation
+    uint64_t getMaterialKey() const { return m_materialKey; }
 
+    // toggles the pieces on the bitboards only (the board array isn't updated), so calling it twice restores them
     void removePieces(PieceType pt, Bitboard bb);
 
   private:
+    // keep the bitboards, board array, occupancies and hashes in step
+    void putPiece(PieceType pt, int square);
+    void removePiece(PieceType pt, int square);
+    void movePiece(PieceType pt, int start, int end);
+
+    // the members are ordered largest first, so that a Position is 216 bytes, within four cache lines
+    // note: the three hashes pushed it past the 192 bytes (three cache lines) it was before, which could only be won
+    //       back by packing the board array into 4-bit squares, and that made move generation about 25% slower
+
+    // GROUP C SKILL: single-dimensional arrays
+    // bitboards for each (piece type, colour) pair
+    Bitboard m_pieces[12];
+    // occupancy of each colour, and of both, updated with the piece bitboards
+    Bitboard m_whiteOccupancy;
+    Bitboard m_blackOccupancy;
+    Bitboard m_occupancy;
+
+    uint64_t m_key;
+    uint64_t m_pawnKey;
+    uint64_t m_materialKey;
+
     // GROUP C SKILL: single-dimensional arrays
     // array of which piece is on each square, so that "what piece is on this square?"
     // can be answered quickly (slow with bitboards)
     PieceType m_board[64];
 
     bool m_whiteToMove;
-    // castling rights
-    bool m_whiteCastleKingside;
-    bool m_whiteCastleQueenside;
-    bool m_blackCastleKingside;
-    bool m_blackCastleQueenside;
+    uint8_t m_castlingRights; // see CastlingRights
+    // square that a pawn skipped over with a double push last move, i.e. where an en passant capture would end up
+    // note: 0 if none, since a1 can never be an en passant square
+    uint8_t m_enPassantSquare;
+    uint16_t m_plysSince50; // number of plys since 50 move rule was reset
 
-    int m_plysSince50; // number of plys since 50 move rule was reset
+};
 
-    // GROUP C SKILL: single-dimensional arrays
-    // bitboards for each (piece type, colour) pair
-    Bitboard m_pieces[12];
+static_assert(sizeof(Position) <= 216, "Position shouldn't grow past the 216 bytes it takes with the hashes");
 
-    // squares that could be affected by en passant next move
-    Bitboard m_enPassant;
+inline Bitboard Position::getEnPassant() const {
+  // squares that could be affected by en passant: the skipped square, and the pawn that skipped it
+  if(m_enPassantSquare == 0) return 0;
+  int pawnSquare = m_whiteToMove ? m_enPassantSquare-8 : m_enPassantSquare+8;
+  return (1ull<<m_enPassantSquare) | (1ull<<pawnSquare);
+}
 
-};
+inline void Position::removePieces(PieceType pt, Bitboard bb) {
+  m_pieces[pt] ^= bb;
+  if(pt < bp) m_whiteOccupancy ^= bb;
+  else m_blackOccupancy ^= bb;
+  m_occupancy ^= bb;
+}
+
+inline void Position::putPiece(PieceType pt, int square) {
+  Bitboard bb = 1ull<<square;
+  m_pieces[pt] |= bb;
+  if(pt < bp) m_whiteOccupancy |= bb;
+  else m_blackOccupancy |= bb;
+  m_occupancy |= bb;
+  m_board[square] = pt;
+  m_key ^= Zobrist::pieces[pt][square];
+  if(pt == wp || pt == bp) m_pawnKey ^= Zobrist::pieces[pt][square];
+  // the material key hashes the nth piece of each type, so only depends on the counts
+  m_materialKey ^= Zobrist::pieces[pt][m_pieces[pt].popcnt()-1];
+}
+
+inline void Position::removePiece(PieceType pt, int square) {
+  Bitboard bb = ~(1ull<<square);
+  m_pieces[pt] &= bb;
+  if(pt < bp) m_whiteOccupancy &= bb;
+  else m_blackOccupancy &= bb;
+  m_occupancy &= bb;
+  m_board[square] = empty;
+  m_key ^= Zobrist::pieces[pt][square];
+  if(pt == wp || pt == bp) m_pawnKey ^= Zobrist::pieces[pt][square];
+  m_materialKey ^= Zobrist::pieces[pt][m_pieces[pt].popcnt()];
+}
+
+inline void Position::movePiece(PieceType pt, int start, int end) {
+  // counts don't change, so the material key is left alone
+  Bitboard bb = (1ull<<start) | (1ull<<end);
+  m_pieces[pt] ^= bb;
+  if(pt < bp) m_whiteOccupancy ^= bb;
+  else m_blackOccupancy ^= bb;
+  m_occupancy ^= bb;
+  m_board[start] = empty;
+  m_board[end] = pt;
+  m_key ^= Zobrist::pieces[pt][start] ^ Zobrist::pieces[pt][end];
+  if(pt == wp || pt == bp) m_pawnKey ^= Zobrist::pieces[pt][start] ^ Zobrist::pieces[pt][end];
+}
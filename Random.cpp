@@ -0,0 +1,18 @@
+#include "Random.h"
+#include <cstdint>
+
+Random::Random(uint64_t seed) {
+  this->seed(seed);
+}
+
+// GROUP C SKILL: bitwise operations
+// the state is filled by splitmix64, so that similar seeds (e.g. one per thread) still give unrelated sequences,
+// and the state is never all zeros
+void Random::seed(uint64_t seed) {
+  for(int i=0; i<4; ++i) {
+    uint64_t z = (seed += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    m_state[i] = z ^ (z >> 31);
+  }
+}
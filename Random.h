@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+// GROUP B SKILL: simple OOP model
+// xoshiro256** pseudorandom number generator, seeded through splitmix64
+// much faster than std::rand, with all 64 bits random, and the same numbers every run for the same seed
+// note: not thread safe, so each thread has its own
+class Random {
+
+  public:
+    static constexpr uint64_t DEFAULT_SEED = 20230101;
+
+    Random(uint64_t seed = DEFAULT_SEED);
+    void seed(uint64_t seed);
+
+    // GROUP C SKILL: bitwise operations
+    uint64_t next() {
+      uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+      uint64_t t = m_state[1] << 17;
+      m_state[2] ^= m_state[0];
+      m_state[3] ^= m_state[1];
+      m_state[1] ^= m_state[2];
+      m_state[0] ^= m_state[3];
+      m_state[2] ^= t;
+      m_state[3] = rotl(m_state[3], 45);
+      return result;
+    }
+
+    // uniform in [0, bound), for bound > 0
+    // note: (next() % bound) would favour small numbers, so this scales a 32-bit number by bound instead,
+    //       rejecting the few numbers that would make some results more likely (Lemire's method)
+    uint32_t nextBelow(uint32_t bound) {
+      uint64_t product = (next() >> 32) * bound;
+      if((uint32_t) product < bound) {
+        uint32_t threshold = -bound % bound; // 2^32 mod bound
+        while((uint32_t) product < threshold) product = (next() >> 32) * bound;
+      }
+      return product >> 32;
+    }
+
+    // a number with about 1/8 of its bits set
+    uint64_t nextSparse() { return next() & next() & next(); }
+
+  private:
+    uint64_t m_state[4];
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+};
@@ -0,0 +1,72 @@
+#include "SearchStats.h"
+#include <cstdint>
+#include <string>
+#include <sstream>
+
+void SearchStats::clear() {
+  threads = 1;
+  nodes = 0;
+  capturesNodes = 0;
+  hashProbes = 0;
+  hashHits = 0;
+  hashCutoffs = 0;
+  cutoffs = 0;
+  firstMoveCutoffs = 0;
+  iterations.clear();
+  unfinishedBestMove = Move(0, 0);
+  time_ms = 0;
+}
+
+void SearchStats::add(const SearchStats& other) {
+  threads += other.threads;
+  nodes += other.nodes;
+  capturesNodes += other.capturesNodes;
+  hashProbes += other.hashProbes;
+  hashHits += other.hashHits;
+  hashCutoffs += other.hashCutoffs;
+  cutoffs += other.cutoffs;
+  firstMoveCutoffs += other.firstMoveCutoffs;
+}
+
+uint64_t SearchStats::getNodesPerSecond() {
+  return time_ms ? nodes*1000/time_ms : 0;
+}
+
+double SearchStats::getBranchingFactor(int i) {
+  if(i == 0) return 0;
+  uint64_t before = 0; // nodes up to iteration (i-1)
+  for(int j=0; j<i; ++j) before += iterations[j].nodes;
+  return before ? (double) (before + iterations[i].nodes) / before : 0;
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+std::string SearchStats::toJSON() {
+  std::ostringstream json;
+#ifdef NO_SEARCH_STATS
+  bool enabled = false;
+#else
+  bool enabled = true;
+#endif
+  json << "{\"enabled\": " << (enabled ? "true" : "false")
+    << ", \"threads\": " << threads
+    << ", \"nodes\": " << nodes
+    << ", \"capturesNodes\": " << capturesNodes
+    << ", \"timeMs\": " << time_ms
+    << ", \"nps\": " << getNodesPerSecond()
+    << ", \"hashProbes\": " << hashProbes
+    << ", \"hashHits\": " << hashHits
+    << ", \"hashCutoffs\": " << hashCutoffs
+    << ", \"cutoffs\": " << cutoffs
+    << ", \"firstMoveCutoffs\": " << firstMoveCutoffs
+    << ", \"firstMoveCutoffRate\": " << (cutoffs ? (double) firstMoveCutoffs/cutoffs : 0)
+    << ", \"mainThreadIterations\": [";
+  for(int i=0; i<(int)iterations.size(); ++i) {
+    if(i) json << ", ";
+    json << "{\"depth\": " << iterations[i].depth
+      << ", \"nodes\": " << iterations[i].nodes
+      << ", \"timeMs\": " << iterations[i].time_ms
+      << ", \"branchingFactor\": " << getBranchingFactor(i) << "}";
+  }
+  json << "]}";
+  return json.str();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Move.h"
+#include <cstdint>
+#include <vector>
+#include <string>
+
+// search statistics are collected unless compiled with -DNO_SEARCH_STATS, in which case the counters are never touched
+#ifdef NO_SEARCH_STATS
+#define SEARCH_STAT(...)
+#else
+#define SEARCH_STAT(...) __VA_ARGS__
+#endif
+
+// GROUP B SKILL: simple OOP model
+// one completed iteration of iterative deepening, by the main thread
+struct IterationStats {
+  int depth;
+  uint64_t nodes; // searched in this iteration alone, by the main thread alone
+  int time_ms; // taken by this iteration alone
+  Move bestMove; // the move that raised alpha last, or failed high, Move(0, 0) if none did
+  Move chosenMove; // the move the search would play if it stopped after this iteration
+};
+
+// GROUP B SKILL: simple OOP model
+// what one thread, or all of them added up, did during a minimax search, to see where the time goes
+struct SearchStats {
+  int threads = 1; // how many threads' counters are added up here
+  uint64_t nodes = 0;
+  uint64_t capturesNodes = 0; // how many of (nodes) were in the captures search
+  // hash table lookups, how many found the position, and how many of those ended the search of it straight away
+  uint64_t hashProbes = 0;
+  uint64_t hashHits = 0;
+  uint64_t hashCutoffs = 0;
+  // number of beta cutoffs in minimaxAB, and how many of them were caused by the first move tried
+  // note: the closer these are, the better the move ordering
+  uint64_t cutoffs = 0;
+  uint64_t firstMoveCutoffs = 0;
+  // only ever the main thread's, since each thread iterates on its own
+  std::vector<IterationStats> iterations;
+  // the best move of an unfinished last iteration, if it was played instead of the last completed iteration's
+  Move unfinishedBestMove = Move(0, 0);
+  int time_ms = 0;
+
+  void clear();
+  // adds the counters of another thread that searched at the same time, but not its iterations or time
+  void add(const SearchStats& other);
+  uint64_t getNodesPerSecond();
+  // effective branching factor: how many times more nodes the search took up to iteration (i) than up to the one
+  // before it (0 for the first)
+  // note: counted from the start of the search, since with several threads the main thread's single iterations
+  //       vary wildly depending on what the others have already put in the hash table
+  double getBranchingFactor(int i);
+  std::string toJSON();
+};
@@ -0,0 +1,43 @@
+#include "TimeManager.h"
+#include <chrono>
+#include <algorithm>
+#include <climits>
+
+void TimeManager::startFixed(int moveTime_ms) {
+  m_start = std::chrono::steady_clock::now();
+  m_softLimit_ms = moveTime_ms;
+  m_hardLimit_ms = moveTime_ms;
+  m_fixed = true;
+}
+
+// GROUP C SKILL: simple mathematical calculations
+// the soft limit is an even share of the clock plus most of the increment, and the hard limit allows
+// up to four times that when an iteration is unfinished, but never more than three quarters of the clock
+void TimeManager::startClock(int time_ms, int increment_ms, int movesToGo) {
+  m_start = std::chrono::steady_clock::now();
+  int available = std::max(time_ms - MOVE_OVERHEAD_MS, 1);
+  int moves = movesToGo > 0 ? movesToGo : DEFAULT_MOVES_TO_GO;
+  int share = available/moves + increment_ms*3/4;
+  m_hardLimit_ms = std::max(std::min(4*share, available*3/4), 1);
+  m_softLimit_ms = std::min(share, m_hardLimit_ms);
+  m_fixed = false;
+}
+
+void TimeManager::startInfinite() {
+  m_start = std::chrono::steady_clock::now();
+  m_softLimit_ms = INT_MAX;
+  m_hardLimit_ms = INT_MAX;
+  m_fixed = true;
+}
+
+int TimeManager::getElapsed() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+bool TimeManager::isSoftLimitReached(double scale) {
+  return getElapsed() >= (m_fixed ? m_softLimit_ms : m_softLimit_ms*scale);
+}
+
+bool TimeManager::isHardLimitReached() {
+  return getElapsed() >= m_hardLimit_ms;
+}
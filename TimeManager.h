@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+
+// GROUP B SKILL: simple OOP model
+// decides how long a search may take, with two deadlines:
+//   the soft limit, after which no new iteration is started, and which shrinks while the best move is stable
+//   the hard limit, at which the search is stopped, even in the middle of an iteration
+class TimeManager {
+
+  public:
+    // a fixed time per move, which is always used up
+    void startFixed(int moveTime_ms);
+    // playing on a clock with (time_ms) left and (increment_ms) added after each move
+    // (movesToGo) is the number of moves until the next time control, or 0 if the time has to last the rest of the game
+    void startClock(int time_ms, int increment_ms, int movesToGo);
+    // no limit, for searches that are stopped some other way
+    void startInfinite();
+
+    int getElapsed();
+    // (scale) multiplies the soft limit, and is ignored for a fixed time per move
+    bool isSoftLimitReached(double scale);
+    bool isHardLimitReached();
+
+  private:
+    std::chrono::time_point<std::chrono::steady_clock> m_start;
+    int m_softLimit_ms;
+    int m_hardLimit_ms;
+    bool m_fixed;
+
+    // kept back from the clock, for the time taken to actually play the move
+    static const int MOVE_OVERHEAD_MS = 20;
+    // the number of moves the time is shared between, if it has to last the rest of the game
+    static const int DEFAULT_MOVES_TO_GO = 30;
+
+};
@@ -0,0 +1,100 @@
+#include "TranspositionTable.h"
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <new>
+
+static_assert(sizeof(HashTableSlot) == 16, "four hash table slots should fit in a cache line");
+static_assert(sizeof(HashTableBucket) == 64, "a hash table bucket should be one cache line");
+
+TranspositionTable::TranspositionTable(int sizeMB) {
+  resize(sizeMB);
+}
+
+bool TranspositionTable::resize(int sizeMB) {
+  uint64_t bytes = (uint64_t) sizeMB << 20;
+  uint64_t buckets = 1;
+  while(buckets*2*sizeof(HashTableBucket) <= bytes) buckets *= 2;
+  // the new table is allocated before the old one is released, so that a failed allocation leaves a usable table
+  HashTableBucket* newBuckets = new (std::nothrow) HashTableBucket[buckets];
+  if(!newBuckets) return false;
+  m_buckets.reset(newBuckets);
+  m_mask = buckets-1;
+  m_generation = 0;
+  return true;
+}
+
+int TranspositionTable::getSizeMB() {
+  return ((m_mask+1) * sizeof(HashTableBucket)) >> 20;
+}
+
+void TranspositionTable::clear() {
+  for(uint64_t i=0; i<=m_mask; ++i) {
+    for(HashTableSlot& slot : m_buckets[i].slots) {
+      slot.keyXorData.store(0, std::memory_order_relaxed);
+      slot.data.store(0, std::memory_order_relaxed);
+    }
+  }
+  m_generation = 0;
+}
+
+void TranspositionTable::newSearch() {
+  m_generation = (m_generation+1) & 63;
+}
+
+// GROUP A SKILL: hashing
+bool TranspositionTable::probe(uint64_t key, HashTableEntry& entry) {
+  HashTableBucket& bucket = m_buckets[key & m_mask];
+  for(HashTableSlot& slot : bucket.slots) {
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    if((slot.keyXorData.load(std::memory_order_relaxed) ^ data) == key) {
+      entry.unpack(data);
+      if(entry.getType() != UNKNOWN) return true;
+    }
+  }
+  return false;
+}
+
+// GROUP A SKILL: hashing
+// if the position is already stored, it is overwritten unless the stored result is from a much deeper search
+// otherwise the entry replaced is the one that is least useful: shallowest, and from the oldest search
+void TranspositionTable::store(uint64_t key, Move move, int score, int depth, HashType type, int eval) {
+  HashTableBucket& bucket = m_buckets[key & m_mask];
+  HashTableSlot* replace = &bucket.slots[0];
+  int lowestValue = 1000000;
+  for(HashTableSlot& slot : bucket.slots) {
+    HashTableEntry entry;
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    entry.unpack(data);
+    if((slot.keyXorData.load(std::memory_order_relaxed) ^ data) == key && entry.getType() != UNKNOWN) {
+      if(type != EXACT && depth < entry.depth-2 && entry.getGeneration() == m_generation) return;
+      // keep the old move if there isn't a new one
+      if(move == Move(0, 0)) move = entry.move;
+      if(eval == HashTableEntry::NO_EVAL) eval = entry.eval;
+      replace = &slot;
+      break;
+    }
+    // empty slots are always replaced first
+    if(entry.getType() == UNKNOWN) {
+      replace = &slot;
+      lowestValue = -1000000;
+      continue;
+    }
+    // each search of age counts as much as 8 plies of depth
+    int age = (m_generation - entry.getGeneration()) & 63;
+    int value = entry.depth - 8*age;
+    if(value < lowestValue) {
+      lowestValue = value;
+      replace = &slot;
+    }
+  }
+  HashTableEntry entry;
+  entry.move = move;
+  entry.score = score;
+  entry.depth = depth;
+  entry.genBound = m_generation<<2 | type;
+  entry.eval = eval;
+  uint64_t data = entry.pack();
+  replace->keyXorData.store(key ^ data, std::memory_order_relaxed);
+  replace->data.store(data, std::memory_order_relaxed);
+}
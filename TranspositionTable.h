@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Move.h"
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+enum HashType {
+  UNKNOWN, LOWER, UPPER, EXACT
+};
+
+// GROUP B SKILL: simple OOP model
+// the result of a search of one position, as read from or written to the table
+struct HashTableEntry {
+  // the depth quiescence (captures only) search results are stored with, below any full width search
+  static const int DEPTH_QUIESCENCE = 0;
+  // stored instead of the static eval when it wasn't worked out (e.g. in check)
+  static const int16_t NO_EVAL = INT16_MIN;
+
+  Move move = Move(0, 0); // best move found, or the move that caused a cutoff
+  int16_t score = 0;
+  uint8_t depth = 0;
+  uint8_t genBound = 0; // bits 0-1 are the HashType, bits 2-7 the generation (search number) it was written in
+  int16_t eval = NO_EVAL; // static eval of the position, so that it isn't worked out again
+
+  HashType getType() { return (HashType) (genBound & 3); }
+  int getGeneration() { return genBound >> 2; }
+
+  // packed into 64 bits: move in bits 0-15, score 16-31, depth 32-39, genBound 40-47, eval 48-63
+  uint64_t pack() {
+    return move.getData() | (uint64_t) (uint16_t) score<<16 | (uint64_t) depth<<32 | (uint64_t) genBound<<40 | (uint64_t) (uint16_t) eval<<48;
+  }
+  void unpack(uint64_t data) {
+    move = Move::fromData(data & 0xffff);
+    score = (int16_t) (data>>16);
+    depth = data>>32;
+    genBound = data>>40;
+    eval = (int16_t) (data>>48);
+  }
+};
+
+// GROUP B SKILL: simple OOP model
+// one slot of the table, 16 bytes so that four fit in a cache line
+// the table is shared by all search threads without locks, so a slot could be read while half written
+// storing (key ^ data) instead of the key means a torn slot fails the key check, rather than giving another position's data
+struct HashTableSlot {
+  std::atomic<uint64_t> keyXorData{0};
+  std::atomic<uint64_t> data{0};
+};
+
+// GROUP B SKILL: simple OOP model
+// slots are grouped into cache-line-sized buckets, so a probe only ever touches one cache line
+struct alignas(64) HashTableBucket {
+  static const int SIZE = 4;
+  HashTableSlot slots[SIZE];
+};
+
+// GROUP A SKILL: complex OOP
+// hash table of previously searched positions, with a size set at runtime
+// note: probe and store may be called from several threads at once, everything else may not
+class TranspositionTable {
+
+  public:
+    // the largest size accepted, well beyond any machine's memory but small enough that the size can't overflow
+    static const int MAX_SIZE_MB = 1<<20;
+
+    TranspositionTable(int sizeMB);
+
+    // reallocates the table with the largest power of 2 number of buckets that fits in (sizeMB), and clears it
+    // returns false, keeping the old table, if there isn't enough memory for the new one
+    bool resize(int sizeMB);
+    int getSizeMB();
+    void clear();
+    // should be called before each search, so that entries from older searches are replaced first
+    void newSearch();
+
+    // GROUP A SKILL: hashing
+    // copies the entry for (key) into (entry) and returns true if found, otherwise returns false
+    bool probe(uint64_t key, HashTableEntry& entry);
+    void store(uint64_t key, Move move, int score, int depth, HashType type, int eval);
+    // start loading the bucket for (key) into the cache, so a later probe doesn't stall
+    void prefetch(uint64_t key) { __builtin_prefetch(&m_buckets[key & m_mask]); }
+
+  private:
+    // GROUP C SKILL: single-dimensional arrays
+    std::unique_ptr<HashTableBucket[]> m_buckets;
+    uint64_t m_mask; // number of buckets minus 1, so that (key & m_mask) is the bucket index
+    uint8_t m_generation; // only the bottom 6 bits are used
+
+};
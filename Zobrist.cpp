@@ -0,0 +1,38 @@
+#include "Zobrist.h"
+#include "Random.h"
+#include <mutex>
+
+uint64_t Zobrist::pieces[12][64];
+uint64_t Zobrist::blackToMove;
+uint64_t Zobrist::castling[16];
+uint64_t Zobrist::enPassant[8];
+std::once_flag Zobrist::m_initialised;
+
+void Zobrist::init() {
+  std::call_once(m_initialised, initTables);
+}
+
+// GROUP B SKILL: simple user-defined algorithms
+void Zobrist::initTables() {
+  // fixed seed, so that hashes are the same every run
+  Random rng;
+  for(int i=0; i<12; ++i) {
+    for(int j=0; j<64; ++j) {
+      pieces[i][j] = rng.next();
+    }
+  }
+  blackToMove = rng.next();
+
+  // each castling right has its own number, and a mask hashes to the xor of its rights
+  // so that changing rights is a single xor of castling[old]^castling[new]
+  uint64_t rights[4];
+  for(int i=0; i<4; ++i) rights[i] = rng.next();
+  for(int mask=0; mask<16; ++mask) {
+    castling[mask] = 0;
+    for(int i=0; i<4; ++i) {
+      if(mask & (1<<i)) castling[mask] ^= rights[i];
+    }
+  }
+
+  for(int i=0; i<8; ++i) enPassant[i] = rng.next();
+}
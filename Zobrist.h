@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+// GROUP B SKILL: simple OOP model
+// pseudorandom numbers used to hash positions, shared by every Position
+// note: the tables are built once by init(), which Position's constructor calls
+struct Zobrist {
+  static void init();
+
+  // GROUP B SKILL: multi-dimensional arrays
+  static uint64_t pieces[12][64]; // each piece at each square
+  static uint64_t blackToMove;
+  static uint64_t castling[16]; // each castling rights mask, see CastlingRights
+  static uint64_t enPassant[8]; // each of the 8 files
+
+  private:
+    static std::once_flag m_initialised;
+    static void initTables();
+};
@@ -6,15 +6,19 @@
 #include <iostream>
 #include <bit>
 #include <string>
+#include <chrono>
 
 // GROUP A SKILL - recursion
 int numPositions(int depth, Position& p, MoveGenerator& m) {
   if(depth == 0) return 1;
   int numPos = 0;
-  for(auto move : m.genMoves(p, false)) {
-    Position next = p;
-    next.makeMove(move);
-    numPos += numPositions(depth-1, next, m);
+  MoveList moves;
+  m.genMoves(p, moves, ALL);
+  for(auto move : moves) {
+    StateInfo state;
+    p.makeMove(move, state);
+    numPos += numPositions(depth-1, p, m);
+    p.unmakeMove(move, state);
   }
   return numPos;
 }
@@ -23,21 +27,81 @@ int numPositions(int depth, Position& p, MoveGenerator& m) {
 void movegenTest(Position p, int depth) {
   MoveGenerator m;
   int total = 0;
-  for(auto move : m.genMoves(p, false)) {
-    Position next = p;
-    next.makeMove(move);
-    int res = numPositions(depth-1, next, m);
-    std::cout << "  " << (char)((move.start&7)+'a') << (move.start>>3)+1
-      << (char)((move.end&7)+'a') << (move.end>>3)+1
+  MoveList moves;
+  m.genMoves(p, moves, ALL);
+  for(auto move : moves) {
+    StateInfo state;
+    p.makeMove(move, state);
+    int res = numPositions(depth-1, p, m);
+    p.unmakeMove(move, state);
+    std::cout << "  " << (char)((move.getStart()&7)+'a') << (move.getStart()>>3)+1
+      << (char)((move.getEnd()&7)+'a') << (move.getEnd()>>3)+1
       << ": " << res << "\n";
     total += res;
   }
   std::cout << "Total at depth " << depth << ": " << total << "\n\n";
 }
 
+// GROUP B SKILL - simple user-defined algorithms
+// checks that the magic and PEXT sliding piece backends agree, then compares them with perft
+void sliderTest(Position p, int depth) {
+  MoveGenerator m;
+  if(!m.isPextSupported()) {
+    std::cout << "PEXT is not supported by this CPU, only magics are available.\n\n";
+    return;
+  }
+  std::cout << "Sliding piece move boards " << (m.verifySliderBackends() ? "match" : "DO NOT match") << " between backends.\n";
+  for(int usePext=0; usePext<2; ++usePext) {
+    m.setUsePext(usePext);
+    auto begin = std::chrono::steady_clock::now();
+    int total = numPositions(depth, p, m);
+    int time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "  " << (usePext ? "PEXT" : "magic") << ": " << total << " positions at depth " << depth << " in " << time << "ms\n";
+  }
+  std::cout << "\n";
+}
+
+// GROUP B SKILL - simple user-defined algorithms
+// checks that after every completed iteration minimax would play the move that raised alpha in it, and that it plays
+// the last one (or the best move of an unfinished iteration after it), on positions where refuted root moves used to
+// be ranked above it
+void searchTest(int time_ms) {
+#ifdef NO_SEARCH_STATS
+  std::cout << "Search statistics are compiled out, so the search can't be checked.\n\n";
+  return;
+#endif
+  std::string FENs[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "3r1k2/4npp1/1ppr3p/p6P/P2PPPP1/1NR5/5K2/2R5 w - - 0 1",
+    "2r3k1/pppR1pp1/4p3/4P1P1/5P2/1P4K1/P1P5/8 w - - 0 1"
+  };
+  int passed = 0;
+  for(std::string FEN : FENs) {
+    Engine e(FEN);
+    Move played = e.minimax(time_ms, false);
+    SearchStats stats = e.getSearchStats();
+    Move expected = stats.unfinishedBestMove;
+    if(expected == Move(0, 0) && !stats.iterations.empty()) expected = stats.iterations.back().bestMove;
+    bool ok = expected == Move(0, 0) || played == expected;
+    for(IterationStats& iteration : stats.iterations) {
+      if(iteration.bestMove != Move(0, 0) && iteration.chosenMove != iteration.bestMove) {
+        std::cout << "  depth " << iteration.depth << " didn't choose the move that raised alpha\n";
+        ok = false;
+      }
+    }
+    if(ok) passed++;
+    std::cout << "  " << FEN << ": played " << (char)((played.getStart()&7)+'a') << (played.getStart()>>3)+1
+      << (char)((played.getEnd()&7)+'a') << (played.getEnd()>>3)+1
+      << ", expected " << (char)((expected.getStart()&7)+'a') << (expected.getStart()>>3)+1
+      << (char)((expected.getEnd()&7)+'a') << (expected.getEnd()>>3)+1 << (ok ? "" : " FAILED") << "\n";
+  }
+  std::cout << passed << "/" << std::size(FENs) << " positions passed.\n\n";
+}
+
 // GROUP B SKILL - simple user-defined algorithms
 Move getUserMove(Engine& e) {
-  std::vector<Move> legalMoves = e.getLegalMoves();
+  MoveList legalMoves = e.getLegalMoves();
   while(true) {
     std::cout << "Enter move: ";
     char startFile, startRank, endFile, endRank;
@@ -49,7 +113,7 @@ Move getUserMove(Engine& e) {
     // check if legal move
     std::vector<Move> possibleMoves;
     for(Move i : legalMoves) {
-      if(start == i.start && end == i.end) {
+      if(start == i.getStart() && end == i.getEnd()) {
         possibleMoves.push_back(i);
       }
     }
@@ -62,7 +126,7 @@ Move getUserMove(Engine& e) {
       while(true) {
         std::cout << "Promote to queen (q), rook (r), bishop (b) or knight(n)? ";
         char piece; std::cin >> piece;
-        bool isWhite = possibleMoves[0].piece < 6;
+        bool isWhite = e.getPos().isWhiteToMove();
         if(piece=='q') {
           promote = isWhite ? wq : bq;
           break;
@@ -81,7 +145,7 @@ Move getUserMove(Engine& e) {
         }
       }
       Move move = possibleMoves[0];
-      return Move(move.start, move.end, move.piece, false, promote, false);
+      return Move(move.getStart(), move.getEnd(), PROMOTION, promote);
     }
 
   }
@@ -151,7 +215,7 @@ int main() {
     int split = line.find(" ");
     std::string command = line.substr(0, split);
     if(command == "help") {
-      std::cout << "\nFormat:\ncommand <argument:type(default_value)> <...> | description \n--------------------------------------------------------------- \n \nhelp | get help about the CLI\n \nperft <depth:int(3)> | calculate the number of games at a certain depth\n \nposition | set/reset the current position\n \nd | display the current position\n \nmcts <time:int(3000)> | run mcts for a set number of milliseconds\n \nmctsab <time:int(3000)> | run mcts-ab for a set number of milliseconds\n \nminimax <time:int(3000)> | run minimax for a set number of milliseconds\n \ngame <debug:bool(false)> | start a game\n \nquit | quit the program \n \n";
+      std::cout << "\nFormat:\ncommand <argument:type(default_value)> <...> | description \n--------------------------------------------------------------- \n \nhelp | get help about the CLI\n \nperft <depth:int(3)> | calculate the number of games at a certain depth\n \nslidertest <depth:int(4)> | check the magic and PEXT sliding piece backends agree, and compare their speed\n \nsearchtest <time:int(1500)> | check minimax plays the best move of its last iteration, searching each test position for a set number of milliseconds\n \nposition | set/reset the current position\n \nd | display the current position\n \nmcts <time:int(3000)> | run mcts for a set number of milliseconds\n \nmctsab <time:int(3000)> | run mcts-ab for a set number of milliseconds\n \nminimax <time:int(3000)> | run minimax for a set number of milliseconds\n \nclock <time:int(60000)> <increment:int(0)> <movestogo:int(0)> | run minimax for a share of a clock with (time) milliseconds left, (increment) added per move, and (movestogo) moves until the next time control (0 if none)\n \nhash <size:int(16)> | set the hash table size in MB (rounded down to a power of 2)\n \nthreads <threads:int(1)> | set the number of threads minimax and MCTS search with\n \nseed <seed:int(20230101)> | reseed the random numbers MCTS uses, to repeat a run (with 1 thread)\n \nstats | print statistics of the last minimax search as JSON\n \noption <name:string> <value:bool(true)> | turn a minimax pruning technique (nullmove, lmr, futility) or MCTS SIMD selection (simd) on or off, or list them if no name is given\n \ngame <debug:bool(false)> | start a game\n \nquit | quit the program \n \n";
 
     } else if(command == "perft") {
       bool valid = true;
@@ -173,11 +237,43 @@ int main() {
         }
       }
       if(valid) movegenTest(e.getPos(), depth);
+    } else if(command == "slidertest") {
+      bool valid = true;
+      int depth = 4;
+      if(line != command) {
+        try {
+          depth = std::stoi(line.substr(split, line.length()));
+          if(depth <= 0) {
+            std::cout << "Error: depth should be at least 1.\n";
+            valid = false;
+          }
+        } catch (...) {
+          std::cout << "Error: invalid argument.\n";
+          valid = false;
+        }
+      }
+      if(valid) sliderTest(e.getPos(), depth);
+    } else if(command == "searchtest") {
+      bool valid = true;
+      int time = 1500;
+      if(line != command) {
+        try {
+          time = std::stoi(line.substr(split, line.length()));
+          if(time <= 0) {
+            std::cout << "Error: time should be positive.\n";
+            valid = false;
+          }
+        } catch (...) {
+          std::cout << "Error: invalid argument.\n";
+          valid = false;
+        }
+      }
+      if(valid) searchTest(time);
     } else if(command == "position") {
       // load FEN
       std::cout << "Enter FEN to load (or press enter to load start position):\n";
       std::string FEN; std::getline(std::cin, FEN);
-      if(!FEN.empty()) e = Engine(FEN);
+      if(!FEN.empty()) e.setPosition(FEN);
     } else if(command == "d") {
       std::cout << (e.getPos().isWhiteToMove() ? "White" : "Black") << " to move.\n";
       e.outputZobrist();
@@ -230,6 +326,109 @@ int main() {
         }
       }
       if(valid) e.minimax(time, true);
+    } else if(command == "clock") {
+      bool valid = true;
+      int time = 60000;
+      int increment = 0;
+      int movesToGo = 0;
+      if(line != command) {
+        try {
+          std::string args = line.substr(split+1, line.length());
+          size_t pos;
+          time = std::stoi(args, &pos);
+          args = args.substr(pos);
+          if(args.find_first_not_of(" ") != std::string::npos) {
+            increment = std::stoi(args, &pos);
+            args = args.substr(pos);
+            if(args.find_first_not_of(" ") != std::string::npos) movesToGo = std::stoi(args);
+          }
+          if(time <= 0 || increment < 0 || movesToGo < 0) {
+            std::cout << "Error: time should be positive, and increment and moves to go not negative.\n";
+            valid = false;
+          }
+        } catch (...) {
+          std::cout << "Error: invalid argument.\n";
+          valid = false;
+        }
+      }
+      if(valid) e.minimax(time, increment, movesToGo, true);
+    } else if(command == "hash") {
+      bool valid = true;
+      int size = 16;
+      if(line != command) {
+        try {
+          size = std::stoi(line.substr(split, line.length()));
+          if(size <= 0) {
+            std::cout << "Error: size should be positive.\n";
+            valid = false;
+          } else if(size > TranspositionTable::MAX_SIZE_MB) {
+            std::cout << "Error: size should be at most " << TranspositionTable::MAX_SIZE_MB << " MB.\n";
+            valid = false;
+          }
+        } catch (...) {
+          std::cout << "Error: invalid argument.\n";
+          valid = false;
+        }
+      }
+      if(valid) {
+        if(!e.setHashSize(size)) std::cout << "Error: not enough memory, keeping the old table.\n";
+        std::cout << "Hash table size set to " << e.getHashSize() << " MB.\n";
+      }
+    } else if(command == "threads") {
+      bool valid = true;
+      int threads = 1;
+      if(line != command) {
+        try {
+          threads = std::stoi(line.substr(split, line.length()));
+          if(threads <= 0) {
+            std::cout << "Error: number of threads should be positive.\n";
+            valid = false;
+          }
+        } catch (...) {
+          std::cout << "Error: invalid argument.\n";
+          valid = false;
+        }
+      }
+      if(valid) {
+        e.setThreads(threads);
+        std::cout << "Using " << e.getThreads() << " threads.\n";
+      }
+    } else if(command == "seed") {
+      bool valid = true;
+      uint64_t seed = Random::DEFAULT_SEED;
+      if(line != command) {
+        try {
+          seed = std::stoull(line.substr(split, line.length()));
+        } catch (...) {
+          std::cout << "Error: invalid argument.\n";
+          valid = false;
+        }
+      }
+      if(valid) {
+        e.setSeed(seed);
+        std::cout << "Random seed set to " << e.getSeed() << ".\n";
+      }
+    } else if(command == "option") {
+      SearchOptions options = e.getSearchOptions();
+      if(line != command) {
+        std::string args = line.substr(split+1, line.length());
+        int valueSplit = args.find(" ");
+        std::string name = args.substr(0, valueSplit);
+        bool value = args == name || args.substr(valueSplit, args.length()) == " true";
+        if(name == "nullmove") options.nullMovePruning = value;
+        else if(name == "lmr") options.lateMoveReductions = value;
+        else if(name == "futility") options.futilityPruning = value;
+        else if(name == "simd") options.simdSelection = value;
+        else std::cout << "Error: unknown option.\n";
+        e.setSearchOptions(options);
+        options = e.getSearchOptions(); // e.g. SIMD can't be turned on without AVX2
+      }
+      std::cout << "nullmove " << (options.nullMovePruning ? "true" : "false")
+        << ", lmr " << (options.lateMoveReductions ? "true" : "false")
+        << ", futility " << (options.futilityPruning ? "true" : "false")
+        << ", simd " << (options.simdSelection ? "true" : "false") << "\n";
+    } else if(command == "stats") {
+      std::cout << e.getSearchStats().toJSON() << "\n";
     } else if(command == "game") {
       bool debug = false;
       if(line != command) {